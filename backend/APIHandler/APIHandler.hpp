@@ -4,6 +4,7 @@
 #include "../json.hpp"
 #include "../Parser.hpp"
 #include "../Type.hpp"
+#include "../WorkloadGenerator.hpp"
 #include "../algorithms/FCFS.hpp"
 #include "../algorithms/SJF.hpp"
 #include "../algorithms/RR.hpp"
@@ -13,8 +14,16 @@
 #include "crow/middlewares/cors.h"
 #include "../algorithms/MLQ_Aging.hpp"
 #include "../algorithms/SJF_Aging.hpp"
+#include "../algorithms/ArrivalOrder.hpp"
+#include "ResultCache.hpp"
+#include "ServiceMetrics.hpp"
+#include "Sha256.hpp"
+#include "WorkerPool.hpp"
 #include <vector>
 #include <string>
+#include <cctype>
+#include <chrono>
+#include <climits>
 
 using json = nlohmann::json;
 
@@ -51,28 +60,62 @@ public:
         CROW_ROUTE(app, "/api/schedule")
         .methods("POST"_method)
         ([](const crow::request& req) {
-            return APIHandler::handleSchedule(req);
+            return APIHandler::measured("schedule", req, APIHandler::handleSchedule);
         });
 
 		CROW_ROUTE(app, "/api/mlq")
-		.methods("POST"_method)(APIHandler::handleMLQSchedule);
+		.methods("POST"_method)
+		([](const crow::request& req) {
+			return APIHandler::measured("mlq", req, APIHandler::handleMLQSchedule);
+		});
 
         CROW_ROUTE(app, "/api/mlfq")
         .methods("POST"_method)
         ([](const crow::request& req) {
-            return APIHandler::handleMLFQSchedule(req);
+            return APIHandler::measured("mlfq", req, APIHandler::handleMLFQSchedule);
         });
 
         CROW_ROUTE(app, "/api/mlq-aging")
         .methods("POST"_method)
         ([](const crow::request& req) {
-            return APIHandler::handleMLQAgingSchedule(req);
+            return APIHandler::measured("mlq-aging", req, APIHandler::handleMLQAgingSchedule);
         });
 
         CROW_ROUTE(app, "/api/sjf-aging")
         .methods("POST"_method)
         ([](const crow::request& req) {
-            return APIHandler::handleSJF_AgingSchedule(req);
+            return APIHandler::measured("sjf-aging", req, APIHandler::handleSJF_AgingSchedule);
+        });
+
+        // Several independent scheduling jobs in one request
+        CROW_ROUTE(app, "/api/batch")
+        .methods("POST"_method)
+        ([](const crow::request& req) {
+            return APIHandler::measured("batch", req, APIHandler::handleBatch);
+        });
+
+        // Every algorithm over the same workload
+        CROW_ROUTE(app, "/api/compare")
+        .methods("POST"_method)
+        ([](const crow::request& req) {
+            return APIHandler::measured("compare", req, APIHandler::handleCompare);
+        });
+
+        // Metrics over a grid of quantum, queue count and aging threshold
+        CROW_ROUTE(app, "/api/sweep")
+        .methods("POST"_method)
+        ([](const crow::request& req) {
+            return APIHandler::measured("sweep", req, APIHandler::handleSweep);
+        });
+
+        // Result cache counters
+        CROW_ROUTE(app, "/api/cache-stats")([](){
+            return APIHandler::handleCacheStats();
+        });
+
+        // Request counters and latency histograms for Prometheus
+        CROW_ROUTE(app, "/metrics")([](){
+            return APIHandler::handleMetrics();
         });
 	}
     
@@ -85,6 +128,383 @@ public:
         }
     }
     
+    // Body encodings the scheduling endpoints accept and return
+    enum class WireFormat { Json, Cbor, MsgPack };
+
+    // Picks the first of JSON, CBOR and MessagePack named in a Content-Type or
+    // Accept header, in the order listed; q-values are not weighed. A header
+    // naming none of them means JSON.
+    static WireFormat wireFormat(const std::string& header) {
+        size_t begin = 0;
+        while (begin < header.size()) {
+            size_t end = header.find(',', begin);
+            if (end == std::string::npos) {
+                end = header.size();
+            }
+
+            std::string media;
+            for (size_t i = begin; i < end && header[i] != ';'; i++) {
+                if (header[i] != ' ' && header[i] != '\t') {
+                    media += static_cast<char>(std::tolower(static_cast<unsigned char>(header[i])));
+                }
+            }
+            if (media == "application/json") {
+                return WireFormat::Json;
+            }
+            if (media == "application/cbor") {
+                return WireFormat::Cbor;
+            }
+            if (media == "application/msgpack" || media == "application/x-msgpack" ||
+                media == "application/vnd.msgpack") {
+                return WireFormat::MsgPack;
+            }
+            begin = end + 1;
+        }
+        return WireFormat::Json;
+    }
+
+    // Decodes a request body in the format named by its Content-Type
+    static json parseBody(const crow::request& req) {
+        switch (wireFormat(req.get_header_value("Content-Type"))) {
+            case WireFormat::Cbor:
+                return json::from_cbor(req.body);
+            case WireFormat::MsgPack:
+                return json::from_msgpack(req.body);
+            default:
+                return json::parse(req.body);
+        }
+    }
+
+    // Finished responses of the scheduling endpoints, shared by all workers
+    static ResultCache& resultCache() {
+        static ResultCache cache;
+        return cache;
+    }
+
+    // Request counters and histograms, shared by all threads
+    static ServiceMetrics& serviceMetrics() {
+        static ServiceMetrics metrics;
+        return metrics;
+    }
+
+    // Calls a route's handler and records the request in serviceMetrics()
+    template <typename Handler>
+    static crow::response measured(const char* endpoint, const crow::request& req, Handler handler) {
+        ServiceMetrics::Request request(serviceMetrics(), endpoint, req.body.size());
+        crow::response res = handler(req);
+        request.finish(res.code, res.body.size());
+        return res;
+    }
+
+    // When a handler received its request; the starting point of a profiled
+    // response
+    struct Receipt {
+        std::chrono::steady_clock::time_point time = std::chrono::steady_clock::now();
+    };
+
+    // Key of a scheduling response in resultCache(): the endpoint, the response
+    // format, and the length and SHA-256 digest of the canonical input (dumped
+    // with sorted keys), so the key stays short however large the workload.
+    // Profiled responses describe their own run and are never cached, so they
+    // get an empty key.
+    static std::string cacheKey(const char* endpoint, const crow::request& req, const json& input_json) {
+        if (input_json.is_object() && input_json.value("profile", false)) {
+            return std::string();
+        }
+        WireFormat format = wireFormat(req.get_header_value("Accept"));
+        std::string input = input_json.dump();
+        return std::string(endpoint) + '\n' + std::to_string(static_cast<int>(format)) + '\n' +
+               std::to_string(input.size()) + '\n' + Sha256::hex(input);
+    }
+
+    // Answers a request from resultCache(). The scheduling handlers call it
+    // right after parsing the body, so a hit reads and generates no processes.
+    static bool cachedResponse(const std::string& key, crow::response& res) {
+        std::shared_ptr<const std::string> body;
+        std::string content_type;
+        if (key.empty() || !resultCache().lookup(key, body, content_type)) {
+            return false;
+        }
+        ServiceMetrics::Request::noteParsed();
+        res = crow::response(200, *body);
+        if (!content_type.empty()) {
+            res.set_header("Content-Type", content_type);
+        }
+        res.set_header("X-Cache", "HIT");
+        return true;
+    }
+
+    // Runs a scheduler, passed as run(sink), into the sink for the format the
+    // Accept header asks for and returns the encoded result. JSON responses
+    // keep the server's default Content-Type. The result is stored under the
+    // request's cacheKey(). With "profile": true the response also has a
+    // "profile" block; it describes this very run, so it bypasses the cache.
+    template <typename Run>
+    static crow::response respond(const std::string& key, const crow::request& req, const json& input_json, Run run,
+                                  const Receipt& received) {
+        ServiceMetrics::Request::noteParsed();
+        WireFormat format = wireFormat(req.get_header_value("Accept"));
+        if (key.empty()) {
+            switch (format) {
+                case WireFormat::Cbor:
+                    return respondProfiled<CborStreamSink>(input_json, run, "application/cbor", received);
+                case WireFormat::MsgPack:
+                    return respondProfiled<MsgPackStreamSink>(input_json, run, "application/msgpack", received);
+                default:
+                    return respondProfiled<JsonStreamSink>(input_json, run, nullptr, received);
+            }
+        }
+        const char* content_type = format == WireFormat::Cbor ? "application/cbor"
+                                   : format == WireFormat::MsgPack ? "application/msgpack" : nullptr;
+        crow::response res;
+        switch (format) {
+            case WireFormat::Cbor:
+                res = respondWith<CborStreamSink>(input_json, run, content_type);
+                break;
+            case WireFormat::MsgPack:
+                res = respondWith<MsgPackStreamSink>(input_json, run, content_type);
+                break;
+            default:
+                res = respondWith<JsonStreamSink>(input_json, run, content_type);
+                break;
+        }
+        if (res.code == 200) {
+            resultCache().store(key, res.body, content_type != nullptr ? content_type : "");
+        }
+        res.set_header("X-Cache", "MISS");
+        return res;
+    }
+
+    template <typename Sink, typename Run>
+    static crow::response respondWith(const json& input_json, Run& run, const char* content_type) {
+        ScratchScope scratch;  // outlives the sink, whose buffers live in it
+        Sink sink;
+        if (!configureOutput(input_json, sink)) {
+            return unsupportedFormat();
+        }
+        run(sink);
+        ServiceMetrics::Request::noteScheduled();
+
+        crow::response res(200, sink.finish("success"));
+        if (content_type != nullptr) {
+            res.set_header("Content-Type", content_type);
+        }
+        return res;
+    }
+
+    template <typename Sink, typename Run>
+    static crow::response respondProfiled(const json& input_json, Run& run, const char* content_type,
+                                          const Receipt& received) {
+        ScratchScope scratch;
+        ProfilingSink<Sink> sink(received.time);
+        if (!configureOutput(input_json, sink)) {
+            return unsupportedFormat();
+        }
+        sink.startRun();
+        run(sink);
+        ServiceMetrics::Request::noteScheduled();
+
+        crow::response res(200, sink.finish("success"));
+        if (content_type != nullptr) {
+            res.set_header("Content-Type", content_type);
+        }
+        return res;
+    }
+
+    // Threads that run batch jobs, shared by all requests
+    static WorkerPool& workerPool() {
+        static WorkerPool pool;
+        return pool;
+    }
+
+    // Builds the synthetic workload described by a "generate" spec
+    static std::vector<Process> generateWorkload(const json& spec_json) {
+        static const size_t max_generated = 10000000;
+        WorkloadSpec spec = WorkloadGenerator::specFromJson(spec_json);
+        if (spec.count > max_generated) {
+            throw std::invalid_argument("generate.count must be at most " + std::to_string(max_generated));
+        }
+        return WorkloadGenerator(spec).generate();
+    }
+
+    // Reads the "processes" array of a job, or generates its workload when it
+    // has a "generate" spec instead. A p_id may be a number or a string
+    // holding one; priority defaults to 0.
+    static std::vector<Process> readProcesses(const json& input_json) {
+        if (input_json.contains("generate")) {
+            return generateWorkload(input_json["generate"]);
+        }
+        std::vector<Process> processes;
+        for (const auto& process : input_json.at("processes")) {
+            Process p;
+            if (process.at("p_id").is_number()) {
+                p.p_id = process["p_id"].get<int>();
+            } else if (process["p_id"].is_string()) {
+                try {
+                    p.p_id = std::stoi(process["p_id"].get<std::string>());
+                } catch (const std::exception& e) {
+                    throw std::invalid_argument("Invalid process ID format: must be convertible to integer");
+                }
+            } else {
+                throw std::invalid_argument("Process ID must be a number or string convertible to number");
+            }
+
+            p.arrival_time = process.at("arrival_time");
+            p.burst_time = process.at("burst_time");
+            p.priority = process.value("priority", 0);
+            processes.push_back(p);
+        }
+        return processes;
+    }
+
+    // readProcesses() for a request handler: a workload that cannot be read or
+    // generated (std::invalid_argument) is the client's error, so res is set
+    // to a 400 response and false returned
+    static bool readRequestProcesses(const json& input_json, std::vector<Process>& processes, crow::response& res) {
+        try {
+            processes = readProcesses(input_json);
+            return true;
+        } catch (const std::invalid_argument& e) {
+            json error_json = {
+                {"status", "error"},
+                {"message", e.what()}
+            };
+            res = crow::response(400, error_json.dump());
+            return false;
+        }
+    }
+
+    // scheduling_type names runAlgorithm() accepts, in key order as json
+    // would dump them
+    static const std::vector<std::string>& algorithmNames() {
+        static const std::vector<std::string> names = {
+            "FCFS", "MLFQ", "MLQ", "MLQ_Aging", "Priority", "RR", "SJF", "SJF_Aging"
+        };
+        return names;
+    }
+
+    // Name of the queue count in a request: /api/mlq has always called it
+    // num_of_queues and the other endpoints num_queues, so every endpoint takes
+    // either, num_queues first
+    static const char* queueCountKey(const json& params) {
+        return params.contains("num_of_queues") && !params.contains("num_queues") ? "num_of_queues" : "num_queues";
+    }
+
+    // Runs the named algorithm over a sorted workload into any sink, reading
+    // quantum, the queue count and aging_threshold from params with each
+    // endpoint's defaults. Throws std::invalid_argument for an unknown algorithm.
+    template <typename Sink>
+    static void runAlgorithm(const std::string& algorithm, const ArrivalOrder& workload, const json& params, Sink& sink) {
+        int quantum = params.value("quantum", algorithm == "RR" ? 1 : 2);
+        int num_queues = params.value(queueCountKey(params), 3);
+        int aging_threshold = params.value("aging_threshold", 50);
+
+        if (algorithm == "FCFS") {
+            FCFS().schedule(workload, sink);
+        } else if (algorithm == "SJF") {
+            SJF().schedule(workload, sink);
+        } else if (algorithm == "RR") {
+            RR().schedule(workload, quantum, sink);
+        } else if (algorithm == "Priority") {
+            Priority().schedule(workload, sink);
+        } else if (algorithm == "MLQ") {
+            MLQ().schedule(workload, num_queues, quantum, sink);
+        } else if (algorithm == "MLFQ") {
+            MLFQ(quantum, num_queues).schedule(workload, sink);
+        } else if (algorithm == "MLQ_Aging") {
+            MLQAging().schedule(workload, num_queues, quantum, aging_threshold, sink);
+        } else if (algorithm == "SJF_Aging") {
+            SJF_Aging().schedule(workload, aging_threshold, sink);
+        } else {
+            throw std::invalid_argument("Unsupported scheduling algorithm");
+        }
+    }
+
+    // Runs one algorithm and returns the same JSON document its own endpoint
+    // would. Throws std::invalid_argument for a run that cannot be made.
+    static std::string runToJson(const std::string& algorithm, const ArrivalOrder& workload, const json& params) {
+        ScratchScope scratch;
+        JsonStreamSink sink;
+        if (!configureOutput(params, sink)) {
+            throw std::invalid_argument("Unsupported ready_queue_format: expected \"snapshot\" or \"delta\"");
+        }
+        runAlgorithm(algorithm, workload, params, sink);
+        return sink.finish("success");
+    }
+
+    // Runs one batch job, named by its scheduling_type
+    static std::string runJob(const json& job) {
+        ArrivalOrder workload(readProcesses(job));
+        return runToJson(job.at("scheduling_type"), workload, job);
+    }
+
+    // Values of a sweep parameter, given either as a number or as
+    // {"from": a, "to": b, "step": s} with step defaulting to 1
+    static std::vector<int> sweepValues(const json& input_json, const char* name, int default_value, int minimum) {
+        static const size_t max_values = 10000;
+        std::vector<int> values;
+        if (!input_json.contains(name)) {
+            values.push_back(default_value);
+        } else if (input_json[name].is_number()) {
+            values.push_back(input_json[name].get<int>());
+        } else {
+            const json& range = input_json[name];
+            int from = range.at("from");
+            int to = range.at("to");
+            int step = range.value("step", 1);
+            if (step <= 0 || to < from) {
+                throw std::invalid_argument(std::string("Invalid range for ") + name);
+            }
+            for (long long value = from; value <= to; value += step) {
+                if (values.size() == max_values) {
+                    throw std::invalid_argument(std::string("Too many values for ") + name);
+                }
+                values.push_back(static_cast<int>(value));
+            }
+        }
+        for (int value : values) {
+            if (value < minimum) {
+                throw std::invalid_argument(std::string(name) + " must be at least " + std::to_string(minimum));
+            }
+        }
+        return values;
+    }
+
+    // Applies the optional output settings of a scheduling request to its sink:
+    // ready_queue_format and snapshot_segments, summary (true or "only"), and
+    // percentiles with percentile_accuracy.
+    // Returns false if ready_queue_format names an unknown format.
+    template <typename Sink>
+    static bool configureOutput(const json& input_json, Sink& sink) {
+        std::string format = input_json.value("ready_queue_format", "snapshot");
+        if (format == "delta") {
+            sink.useDeltaFormat(input_json.value("snapshot_segments", std::vector<int>()));
+        } else if (format != "snapshot") {
+            return false;
+        }
+
+        auto summary = input_json.find("summary");
+        if (summary != input_json.end()) {
+            if (summary->is_string() && *summary == "only") {
+                sink.useSummary(true);
+            } else if (summary->is_boolean() && summary->get<bool>()) {
+                sink.useSummary();
+            }
+        }
+        if (input_json.value("percentiles", false)) {
+            sink.usePercentiles(QuantileSketch::bitsFor(input_json.value("percentile_accuracy", 0.01)));
+        }
+        return true;
+    }
+
+    static crow::response unsupportedFormat() {
+        json error_json = {
+            {"status", "error"},
+            {"message", "Unsupported ready_queue_format: expected \"snapshot\" or \"delta\""}
+        };
+        return crow::response(400, error_json.dump());
+    }
+
     // Route handler methods
     static crow::response handleRoot() {
         json response_json = {
@@ -102,76 +522,91 @@ public:
         return crow::response(response_json.dump());
     }
     
+    static crow::response handleMetrics() {
+        crow::response res(200, serviceMetrics().exposition());
+        res.set_header("Content-Type", "text/plain; version=0.0.4");
+        return res;
+    }
+
+    static crow::response handleCacheStats() {
+        ResultCache::Stats stats = resultCache().stats();
+        json response_json = {
+            {"status", "success"},
+            {"hits", stats.hits},
+            {"misses", stats.misses},
+            {"evictions", stats.evictions},
+            {"entries", stats.entries},
+            {"bytes", stats.bytes}
+        };
+        return crow::response(response_json.dump());
+    }
+    
     static crow::response handleSchedule(const crow::request& req) {
+        Receipt received;
         try {
-            // Parse JSON from request body
-            auto req_body = crow::json::load(req.body);
-            if (!req_body) {
-                json error_json = {
-                    {"status", "error"},
-                    {"message", "Invalid JSON data"}
-                };
-                return crow::response(400, error_json.dump());
-            }
-
-            // Convert from crow::json to nlohmann::json
-            json input_json = json::parse(req.body);
-            
-            // Extract processes
-            std::vector<Process> processes;
-            for (const auto& process : input_json["processes"]) {
-                Process p;
-                // Ensure p_id is handled as an integer
-                if (process["p_id"].is_number()) {
-                    p.p_id = process["p_id"].get<int>();
-                } else if (process["p_id"].is_string()) {
-                    // Handle string conversion to integer if necessary
-                    try {
-                        p.p_id = std::stoi(process["p_id"].get<std::string>());
-                    } catch (const std::exception& e) {
-                        json error_json = {
-                            {"status", "error"},
-                            {"message", "Invalid process ID format: must be convertible to integer"}
-                        };
-                        return crow::response(400, error_json.dump());
-                    }
-                } else {
+            // Parse the request body; JSON bodies are validated first
+            if (wireFormat(req.get_header_value("Content-Type")) == WireFormat::Json) {
+                auto req_body = crow::json::load(req.body);
+                if (!req_body) {
                     json error_json = {
                         {"status", "error"},
-                        {"message", "Process ID must be a number or string convertible to number"}
+                        {"message", "Invalid JSON data"}
                     };
                     return crow::response(400, error_json.dump());
                 }
-                
-                p.arrival_time = process["arrival_time"];
-                p.burst_time = process["burst_time"];
-                p.priority = process.value("priority", 0);  // Default priority to 0 if not provided
-                processes.push_back(p);
+            }
+            json input_json = parseBody(req);
+            std::string key = cacheKey("schedule", req, input_json);
+            crow::response cached;
+            if (cachedResponse(key, cached)) {
+                ServiceMetrics::Request::noteAlgorithm(input_json["scheduling_type"].get<std::string>());
+                return cached;
+            }
+            
+            if (!input_json.contains("processes") && !input_json.contains("generate")) {
+                return crow::response(400, "{\"status\": \"error\", \"message\": \"Missing processes field\"}");
+            }
+
+            // Extract processes, or generate them from a "generate" spec
+            std::vector<Process> processes;
+            crow::response invalid;
+            if (!readRequestProcesses(input_json, processes, invalid)) {
+                return invalid;
             }
 
             // Get scheduling algorithm type
             std::string algorithm = input_json["scheduling_type"];
+            ServiceMetrics::Request::noteAlgorithm(algorithm);
 
-            // Run appropriate algorithm
-            json result;
+            // Run appropriate algorithm, serializing its output as it runs
             if (algorithm == "FCFS") {
-                FCFS fcfs;
-                result = fcfs.schedule(processes);
+                return respond(key, req, input_json, [&](auto& sink) {
+                    FCFS fcfs;
+                    fcfs.schedule(processes, sink);
+                }, received);
             } else if (algorithm == "SJF") {
-                SJF sjf;
-                result = sjf.schedule(processes);
+                return respond(key, req, input_json, [&](auto& sink) {
+                    SJF sjf;
+                    sjf.schedule(processes, sink);
+                }, received);
             } else if (algorithm == "RR") {
                 int quantum = input_json.value("quantum", 1);  // Default quantum to 1 if not provided
-                RR rr;
-                result = rr.schedule(processes,quantum);
+                return respond(key, req, input_json, [&](auto& sink) {
+                    RR rr;
+                    rr.schedule(processes, quantum, sink);
+                }, received);
             } else if (algorithm == "Priority") {
-                Priority priority;
-                result = priority.schedule(processes);
+                return respond(key, req, input_json, [&](auto& sink) {
+                    Priority priority;
+                    priority.schedule(processes, sink);
+                }, received);
             } else if (algorithm == "MLQ") {
-				int num_queues = input_json.value("num_queues", 3);  // Default to 3 queues if not provided
-				int base_quantum = input_json.value("quantum", 2);   // Default base quantum to 2 if not provided
-				MLQ mlq;
-				result = mlq.schedule(processes, num_queues, base_quantum);
+                int num_queues = input_json.value(queueCountKey(input_json), 3);  // Default to 3 queues if not provided
+                int base_quantum = input_json.value("quantum", 2);   // Default base quantum to 2 if not provided
+                return respond(key, req, input_json, [&](auto& sink) {
+                    MLQ mlq;
+                    mlq.schedule(processes, num_queues, base_quantum, sink);
+                }, received);
             } else {
                 json error_json = {
                     {"status", "error"},
@@ -179,12 +614,6 @@ public:
                 };
                 return crow::response(400, error_json.dump());
             }
-
-            // Ensure the result has the correct status
-            result["status"] = "success";
-            
-            // Return the result as JSON
-            return crow::response(result.dump());
         } catch (const std::exception& e) {
             json error_json = {
                 {"status", "error"},
@@ -195,66 +624,37 @@ public:
     }
 
 	static crow::response handleMLQSchedule(const crow::request& req) {
+		Receipt received;
 		try {
-			auto input_json = json::parse(req.body);
+			ServiceMetrics::Request::noteAlgorithm("MLQ");
+			auto input_json = parseBody(req);
+			std::string key = cacheKey("mlq", req, input_json);
+			crow::response cached;
+			if (cachedResponse(key, cached)) {
+				return cached;
+			}
 			
 			// Validate input
-			if (!input_json.contains("processes")) {
+			if (!input_json.contains("processes") && !input_json.contains("generate")) {
 				return crow::response(400, "{\"status\": \"error\", \"message\": \"Missing processes field\"}");
 			}
 			
-			// Parse processes
+			// Parse processes, or generate them from a "generate" spec
 			vector<Process> processes;
-			for (const auto& p : input_json["processes"]) {
-				Process process;
-                
-                // Ensure p_id is handled as an integer
-                if (p["p_id"].is_number()) {
-                    process.p_id = p["p_id"].get<int>();
-                } else if (p["p_id"].is_string()) {
-                    // Handle string conversion to integer if necessary
-                    try {
-                        process.p_id = std::stoi(p["p_id"].get<std::string>());
-                    } catch (const std::exception& e) {
-                        json error_json = {
-                            {"status", "error"},
-                            {"message", "Invalid process ID format in MLQ request: must be convertible to integer"}
-                        };
-                        return crow::response(400, error_json.dump());
-                    }
-                } else {
-                    json error_json = {
-                        {"status", "error"},
-                        {"message", "Process ID in MLQ request must be a number or string convertible to number"}
-                    };
-                    return crow::response(400, error_json.dump());
-                }
-				
-				process.arrival_time = p["arrival_time"];
-				process.burst_time = p["burst_time"];
-				
-				// Priority is important for MLQ
-				if (p.contains("priority")) {
-					process.priority = p["priority"];
-				} else {
-					process.priority = 0;
-				}
-				
-				processes.push_back(process);
+			crow::response invalid;
+			if (!readRequestProcesses(input_json, processes, invalid)) {
+				return invalid;
 			}
 			
 			// Get MLQ specific parameters
-			int num_queues = input_json.value("num_of_queues", 3);  // Default to 3 queues if not provided
+			int num_queues = input_json.value(queueCountKey(input_json), 3);  // Default to 3 queues if not provided
 			int base_quantum = input_json.value("quantum", 2);   // Default base quantum to 2 if not provided
 			
 			// Run MLQ algorithm
-			MLQ mlq;
-			json result = mlq.schedule(processes, num_queues, base_quantum);
-			
-			// Ensure the result has the correct status
-			result["status"] = "success";
-			
-			return crow::response(200, result.dump());
+			return respond(key, req, input_json, [&](auto& sink) {
+				MLQ mlq;
+				mlq.schedule(processes, num_queues, base_quantum, sink);
+			}, received);
 		} catch (const std::exception& e) {
 			json error_json = {
 				{"status", "error"},
@@ -265,44 +665,37 @@ public:
 	}
 
     static crow::response handleMLFQSchedule(const crow::request& req) {
+        Receipt received;
         try {
-            auto input_json = json::parse(req.body);
+            ServiceMetrics::Request::noteAlgorithm("MLFQ");
+            auto input_json = parseBody(req);
+            std::string key = cacheKey("mlfq", req, input_json);
+            crow::response cached;
+            if (cachedResponse(key, cached)) {
+                return cached;
+            }
             
             // Validate input
-            if (!input_json.contains("processes")) {
+            if (!input_json.contains("processes") && !input_json.contains("generate")) {
                 return crow::response(400, "{\"status\": \"error\", \"message\": \"Missing processes field\"}");
             }
             
-            // Parse processes
+            // Parse processes, or generate them from a "generate" spec
             vector<Process> processes;
-            for (const auto& p : input_json["processes"]) {
-                Process process;
-                process.p_id = p["p_id"];
-                process.arrival_time = p["arrival_time"];
-                process.burst_time = p["burst_time"];
-                
-                // Priority is important for MLFQ
-                if (p.contains("priority")) {
-                    process.priority = p["priority"];
-                } else {
-                    process.priority = 0;
-                }
-                
-                processes.push_back(process);
+            crow::response invalid;
+            if (!readRequestProcesses(input_json, processes, invalid)) {
+                return invalid;
             }
             
             // Get MLFQ specific parameters
-            int num_queues = input_json.value("num_queues", 3);  // Default to 3 queues if not provided
+            int num_queues = input_json.value(queueCountKey(input_json), 3);  // Default to 3 queues if not provided
             int base_quantum = input_json.value("quantum", 2);   // Default base quantum to 2 if not provided
             
             // Run MLFQ algorithm
-            MLFQ mlfq(base_quantum, num_queues);
-            json result = mlfq.schedule(processes);
-            
-            // Ensure the result has the correct status
-            result["status"] = "success";
-            
-            return crow::response(200, result.dump());
+            return respond(key, req, input_json, [&](auto& sink) {
+                MLFQ mlfq(base_quantum, num_queues);
+                mlfq.schedule(processes, sink);
+            }, received);
         } catch (const std::exception& e) {
             json error_json = {
                 {"status", "error"},
@@ -313,44 +706,38 @@ public:
     }
 
     static crow::response handleMLQAgingSchedule(const crow::request& req) {
+        Receipt received;
         try {
-            auto input_json = json::parse(req.body);
+            ServiceMetrics::Request::noteAlgorithm("MLQ_Aging");
+            auto input_json = parseBody(req);
+            std::string key = cacheKey("mlq-aging", req, input_json);
+            crow::response cached;
+            if (cachedResponse(key, cached)) {
+                return cached;
+            }
             
             // Validate input
-            if (!input_json.contains("processes")) {
+            if (!input_json.contains("processes") && !input_json.contains("generate")) {
                 return crow::response(400, "{\"status\": \"error\", \"message\": \"Missing processes field\"}");
             }
             
-            // Parse processes
+            // Parse processes, or generate them from a "generate" spec
             vector<Process> processes;
-            for (const auto& p : input_json["processes"]) {
-                Process process;
-                process.p_id = p["p_id"];
-                process.arrival_time = p["arrival_time"];
-                process.burst_time = p["burst_time"];
-                
-                // Priority is important for MLQ
-                if (p.contains("priority")) {
-                    process.priority = p["priority"];
-                } else {
-                    process.priority = 0;
-                }
-                
-                processes.push_back(process);
+            crow::response invalid;
+            if (!readRequestProcesses(input_json, processes, invalid)) {
+                return invalid;
             }
             
             // Get MLQ specific parameters
-            int num_queues = input_json.value("num_queues", 3);  // Default to 3 queues if not provided
+            int num_queues = input_json.value(queueCountKey(input_json), 3);  // Default to 3 queues if not provided
             int base_quantum = input_json.value("quantum", 2);   // Default base quantum to 2 if not provided
+            int aging_threshold = input_json.value("aging_threshold", 50);  // Default to 50 if not provided
             
             // Run MLQ algorithm
-            MLQAging mlq_aging;
-            json result = mlq_aging.schedule(processes, num_queues, base_quantum);
-            
-            // Ensure the result has the correct status
-            result["status"] = "success";
-            
-            return crow::response(200, result.dump());
+            return respond(key, req, input_json, [&](auto& sink) {
+                MLQAging mlq_aging;
+                mlq_aging.schedule(processes, num_queues, base_quantum, aging_threshold, sink);
+            }, received);
         } catch (const std::exception& e) {
             json error_json = {
                 {"status", "error"},
@@ -361,43 +748,36 @@ public:
     }
 
     static crow::response handleSJF_AgingSchedule(const crow::request& req) {
+        Receipt received;
         try {
-            auto input_json = json::parse(req.body);
+            ServiceMetrics::Request::noteAlgorithm("SJF_Aging");
+            auto input_json = parseBody(req);
+            std::string key = cacheKey("sjf-aging", req, input_json);
+            crow::response cached;
+            if (cachedResponse(key, cached)) {
+                return cached;
+            }
             
             // Validate input
-            if (!input_json.contains("processes")) {
+            if (!input_json.contains("processes") && !input_json.contains("generate")) {
                 return crow::response(400, "{\"status\": \"error\", \"message\": \"Missing processes field\"}");
             }
             
-            // Parse processes
+            // Parse processes, or generate them from a "generate" spec
             vector<Process> processes;
-            for (const auto& p : input_json["processes"]) {
-                Process process;
-                process.p_id = p["p_id"];
-                process.arrival_time = p["arrival_time"];
-                process.burst_time = p["burst_time"];
-                
-                // Priority is important for MLQ
-                if (p.contains("priority")) {
-                    process.priority = p["priority"];
-                } else {
-                    process.priority = 0;
-                }
-                
-                processes.push_back(process);
+            crow::response invalid;
+            if (!readRequestProcesses(input_json, processes, invalid)) {
+                return invalid;
             }
             
             // Get SJF specific parameters
             int aging_threshold = input_json.value("aging_threshold", 50);  // Default to 50 if not provided
             
             // Run SJF algorithm
-            SJF_Aging sjf_aging;
-            json result = sjf_aging.schedule(processes, aging_threshold);
-            
-            // Ensure the result has the correct status
-            result["status"] = "success";
-            
-            return crow::response(200, result.dump());
+            return respond(key, req, input_json, [&](auto& sink) {
+                SJF_Aging sjf_aging;
+                sjf_aging.schedule(processes, aging_threshold, sink);
+            }, received);
         } catch (const std::exception& e) {
             json error_json = {
                 {"status", "error"},
@@ -406,4 +786,217 @@ public:
             return crow::response(500, error_json.dump());
         }
     }
+
+    // Runs every job of {"jobs": [...]} on the worker pool and returns
+    // {"results": [...]} in job order. A job that fails gets an error object
+    // in its slot and does not affect the others.
+    static crow::response handleBatch(const crow::request& req) {
+        static const size_t max_jobs = 1000;
+        try {
+            ServiceMetrics::Request::noteAlgorithm("all");
+            json input_json = parseBody(req);
+            if (!input_json.contains("jobs") || !input_json["jobs"].is_array()) {
+                return crow::response(400, "{\"status\": \"error\", \"message\": \"Missing jobs array\"}");
+            }
+            const json& jobs = input_json["jobs"];
+            if (jobs.size() > max_jobs) {
+                json error_json = {
+                    {"status", "error"},
+                    {"message", "Too many jobs: at most " + std::to_string(max_jobs) + " per batch"}
+                };
+                return crow::response(400, error_json.dump());
+            }
+
+            ServiceMetrics::Request::noteParsed();
+            std::vector<std::future<std::string>> results;
+            results.reserve(jobs.size());
+            for (const json& job : jobs) {
+                results.push_back(workerPool().submit([&job] {
+                    return runJob(job);
+                }));
+            }
+            for (auto& result : results) {
+                result.wait();
+            }
+            ServiceMetrics::Request::noteScheduled();
+
+            std::string body = "{\"results\":[";
+            for (size_t i = 0; i < results.size(); i++) {
+                if (i > 0) {
+                    body += ',';
+                }
+                try {
+                    body += results[i].get();
+                } catch (const std::exception& e) {
+                    json error_json = {
+                        {"status", "error"},
+                        {"message", e.what()}
+                    };
+                    body += error_json.dump();
+                }
+            }
+            body += "],\"status\":\"success\"}";
+            return crow::response(200, body);
+        } catch (const std::exception& e) {
+            json error_json = {
+                {"status", "error"},
+                {"message", std::string("Error processing batch request: ") + e.what()}
+            };
+            return crow::response(500, error_json.dump());
+        }
+    }
+
+    // Runs all eight algorithms over one workload, parsed and sorted once and
+    // shared read-only, on the worker pool. Returns each algorithm's result
+    // under "results", keyed by its scheduling_type name.
+    static crow::response handleCompare(const crow::request& req) {
+        try {
+            ServiceMetrics::Request::noteAlgorithm("all");
+            json input_json = parseBody(req);
+            if (!input_json.contains("processes") && !input_json.contains("generate")) {
+                return crow::response(400, "{\"status\": \"error\", \"message\": \"Missing processes field\"}");
+            }
+
+            std::vector<Process> processes;
+            crow::response invalid;
+            if (!readRequestProcesses(input_json, processes, invalid)) {
+                return invalid;
+            }
+            std::string format = input_json.value("ready_queue_format", "snapshot");
+            if (format != "snapshot" && format != "delta") {
+                return unsupportedFormat();
+            }
+
+            ArrivalOrder workload(std::move(processes));
+            ServiceMetrics::Request::noteParsed();
+            std::vector<std::future<std::string>> results;
+            for (const std::string& algorithm : algorithmNames()) {
+                results.push_back(workerPool().submit([&algorithm, &workload, &input_json] {
+                    return runToJson(algorithm, workload, input_json);
+                }));
+            }
+            for (auto& result : results) {
+                result.wait();
+            }
+            ServiceMetrics::Request::noteScheduled();
+
+            std::string body = "{\"results\":{";
+            for (size_t i = 0; i < results.size(); i++) {
+                if (i > 0) {
+                    body += ',';
+                }
+                body += json(algorithmNames()[i]).dump() + ':';
+                try {
+                    body += results[i].get();
+                } catch (const std::exception& e) {
+                    json error_json = {
+                        {"status", "error"},
+                        {"message", e.what()}
+                    };
+                    body += error_json.dump();
+                }
+            }
+            body += "},\"status\":\"success\"}";
+            return crow::response(200, body);
+        } catch (const std::exception& e) {
+            json error_json = {
+                {"status", "error"},
+                {"message", std::string("Error processing compare request: ") + e.what()}
+            };
+            return crow::response(500, error_json.dump());
+        }
+    }
+
+    // Runs one algorithm over every point of a parameter grid on the worker
+    // pool and returns a metrics table instead of Gantt charts. quantum,
+    // the queue count and aging_threshold may each be a number or a range; each
+    // row holds the point followed by its metrics, or nulls if the point was
+    // rejected by the scheduler.
+    static crow::response handleSweep(const crow::request& req) {
+        static const size_t max_points = 10000;
+        try {
+            json input_json = parseBody(req);
+            if (!input_json.contains("processes") && !input_json.contains("generate")) {
+                return crow::response(400, "{\"status\": \"error\", \"message\": \"Missing processes field\"}");
+            }
+
+            std::string algorithm;
+            std::vector<Process> processes;
+            std::vector<int> quanta, queue_counts, thresholds;
+            try {
+                algorithm = input_json.at("scheduling_type");
+                ServiceMetrics::Request::noteAlgorithm(algorithm);
+                if (std::find(algorithmNames().begin(), algorithmNames().end(), algorithm) == algorithmNames().end()) {
+                    throw std::invalid_argument("Unsupported scheduling algorithm");
+                }
+                processes = readProcesses(input_json);
+                quanta = sweepValues(input_json, "quantum", algorithm == "RR" ? 1 : 2, 1);
+                queue_counts = sweepValues(input_json, queueCountKey(input_json), 3, 1);
+                thresholds = sweepValues(input_json, "aging_threshold", 50, INT_MIN);
+                if (quanta.size() * queue_counts.size() * thresholds.size() > max_points) {
+                    throw std::invalid_argument("Too many parameter points: at most " + std::to_string(max_points) + " per sweep");
+                }
+            } catch (const std::invalid_argument& e) {
+                json error_json = {
+                    {"status", "error"},
+                    {"message", e.what()}
+                };
+                return crow::response(400, error_json.dump());
+            }
+
+            ArrivalOrder workload(std::move(processes));
+            ServiceMetrics::Request::noteParsed();
+            std::vector<std::future<json>> results;
+            for (int quantum : quanta) {
+                for (int num_queues : queue_counts) {
+                    for (int aging_threshold : thresholds) {
+                        results.push_back(workerPool().submit([&, quantum, num_queues, aging_threshold] {
+                            json params = {
+                                {"quantum", quantum},
+                                {"num_queues", num_queues},
+                                {"aging_threshold", aging_threshold}
+                            };
+                            ScratchScope scratch;
+                            MetricsSink sink;
+                            runAlgorithm(algorithm, workload, params, sink);
+
+                            json row = {quantum, num_queues, aging_threshold};
+                            if (sink.ok()) {
+                                row.push_back(sink.summary.averageWaitingTime());
+                                row.push_back(sink.summary.averageTurnaroundTime());
+                                row.push_back(sink.summary.averageResponseTime());
+                                row.push_back(sink.summary.context_switches);
+                            } else {
+                                row.insert(row.end(), 4, nullptr);
+                            }
+                            return row;
+                        }));
+                    }
+                }
+            }
+
+            // Every task refers to this frame, so let them all finish first
+            for (auto& result : results) {
+                result.wait();
+            }
+            ServiceMetrics::Request::noteScheduled();
+            json rows = json::array();
+            for (auto& result : results) {
+                rows.push_back(result.get());
+            }
+            json response_json = {
+                {"status", "success"},
+                {"columns", {"quantum", "num_queues", "aging_threshold", "avg_waiting_time",
+                             "avg_turnaround_time", "avg_response_time", "context_switches"}},
+                {"rows", std::move(rows)}
+            };
+            return crow::response(200, response_json.dump());
+        } catch (const std::exception& e) {
+            json error_json = {
+                {"status", "error"},
+                {"message", std::string("Error processing sweep request: ") + e.what()}
+            };
+            return crow::response(500, error_json.dump());
+        }
+    }
 };
\ No newline at end of file
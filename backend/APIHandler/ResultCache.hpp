@@ -0,0 +1,129 @@
+#ifndef RESULT_CACHE_HPP
+#define RESULT_CACHE_HPP
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Bounded LRU cache of encoded scheduling responses, keyed by a short digest
+// of the request's canonical form (see APIHandler::cacheKey()). The cache is
+// split into shards by key hash, each with its own lock and its own share of
+// the byte budget, so concurrent requests rarely contend. A stored entry keeps
+// its full key, so a collision of the shard-index hash is a miss, never a
+// wrong result. Bodies are shared, so a hit copies no response bytes under
+// the lock.
+class ResultCache {
+public:
+    struct Entry {
+        string key;
+        shared_ptr<const string> body;
+        string content_type;  // empty for the server's default
+    };
+
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        size_t entries;
+        size_t bytes;
+    };
+
+private:
+    struct Shard {
+        mutex lock;
+        list<Entry> lru;  // most recently used first
+        unordered_map<size_t, list<Entry>::iterator> index;  // key hash -> entry
+        size_t bytes = 0;
+    };
+
+    static constexpr size_t shard_count = 16;
+    vector<Shard> shards;
+    size_t shard_capacity;
+    atomic<uint64_t> hits{0};
+    atomic<uint64_t> misses{0};
+    atomic<uint64_t> evictions{0};
+
+    static size_t footprint(const Entry& entry) {
+        return entry.key.size() + entry.body->size() + entry.content_type.size();
+    }
+
+    Shard& shardFor(size_t hash) {
+        return shards[hash % shard_count];
+    }
+
+public:
+    explicit ResultCache(size_t capacity_bytes = 64 * 1024 * 1024)
+        : shards(shard_count), shard_capacity(capacity_bytes / shard_count) {}
+
+    // Points `body` and `content_type` at the response stored under `key` and
+    // marks it most recently used. Returns false on a miss.
+    bool lookup(const string& key, shared_ptr<const string>& body, string& content_type) {
+        size_t hash = std::hash<string>()(key);
+        Shard& shard = shardFor(hash);
+        {
+            lock_guard<mutex> guard(shard.lock);
+            auto it = shard.index.find(hash);
+            if (it != shard.index.end() && it->second->key == key) {
+                shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+                body = it->second->body;
+                content_type = it->second->content_type;
+                hits++;
+                return true;
+            }
+        }
+        misses++;
+        return false;
+    }
+
+    // Stores a response, evicting least recently used entries of its shard
+    // until it fits. Responses larger than a shard's budget are not kept.
+    void store(const string& key, const string& body, const string& content_type) {
+        Entry entry{key, make_shared<const string>(body), content_type};
+        size_t size = footprint(entry);
+        if (size > shard_capacity) {
+            return;
+        }
+
+        size_t hash = std::hash<string>()(key);
+        Shard& shard = shardFor(hash);
+        lock_guard<mutex> guard(shard.lock);
+        auto it = shard.index.find(hash);
+        if (it != shard.index.end()) {
+            shard.bytes -= footprint(*it->second);
+            shard.lru.erase(it->second);
+            shard.index.erase(it);
+        }
+        while (!shard.lru.empty() && shard.bytes + size > shard_capacity) {
+            const Entry& oldest = shard.lru.back();
+            shard.bytes -= footprint(oldest);
+            shard.index.erase(std::hash<string>()(oldest.key));
+            shard.lru.pop_back();
+            evictions++;
+        }
+
+        shard.lru.push_front(move(entry));
+        shard.index[hash] = shard.lru.begin();
+        shard.bytes += size;
+    }
+
+    Stats stats() {
+        Stats result{hits.load(), misses.load(), evictions.load(), 0, 0};
+        for (Shard& shard : shards) {
+            lock_guard<mutex> guard(shard.lock);
+            result.entries += shard.lru.size();
+            result.bytes += shard.bytes;
+        }
+        return result;
+    }
+};
+
+#endif
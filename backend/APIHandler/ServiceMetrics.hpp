@@ -0,0 +1,323 @@
+#ifndef SERVICE_METRICS_HPP
+#define SERVICE_METRICS_HPP
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Request counters and histograms of the scheduling endpoints, exported in
+// the Prometheus text format. Every thread that handles requests records
+// into a shard of its own, so recording takes no lock and shares no cache
+// line; a scrape adds the shards up. Each shard counter has a single writer,
+// which updates it with a relaxed load and store, and may be read at any
+// time by a scrape.
+class ServiceMetrics {
+public:
+    // Endpoint label of every measured route
+    static const vector<string>& endpoints() {
+        static const vector<string> names = {
+            "schedule", "mlq", "mlfq", "mlq-aging", "sjf-aging", "batch", "compare", "sweep"
+        };
+        return names;
+    }
+
+    // Algorithm labels: each scheduling_type, "all" for requests that run
+    // several, and "none" until a request names one
+    static const vector<string>& algorithms() {
+        static const vector<string> names = {
+            "FCFS", "MLFQ", "MLQ", "MLQ_Aging", "Priority", "RR", "SJF", "SJF_Aging", "all", "none"
+        };
+        return names;
+    }
+
+private:
+    // Log-linear buckets with two per power of two: 1, 2, 3, 4, 6, 8, 12, ...
+    // up to 2^40. Latencies are kept in microseconds and sizes in bytes.
+    static const vector<uint64_t>& bounds() {
+        static const vector<uint64_t> limits = [] {
+            vector<uint64_t> result = {1};
+            for (int power = 1; power <= 40; power++) {
+                uint64_t value = uint64_t(1) << power;
+                result.push_back(value);
+                if (power < 40) {
+                    result.push_back(value + value / 2);
+                }
+            }
+            return result;
+        }();
+        return limits;
+    }
+
+    template <typename Count>
+    static void add(atomic<Count>& counter, Count amount) {
+        counter.store(counter.load(memory_order_relaxed) + amount, memory_order_relaxed);
+    }
+
+    struct Histogram {
+        vector<atomic<uint64_t>> buckets;  // one past the last bound for the overflow
+        atomic<uint64_t> sum{0};
+
+        Histogram() : buckets(bounds().size() + 1) {}
+
+        void record(uint64_t value) {
+            size_t bucket = lower_bound(bounds().begin(), bounds().end(), value) - bounds().begin();
+            add(buckets[bucket], uint64_t(1));
+            add(sum, value);
+        }
+    };
+
+    enum Phase { Parse, Schedule, Serialize, phase_count };
+
+    struct Series {
+        atomic<uint64_t> requests{0};
+        atomic<uint64_t> errors{0};
+        array<Histogram, phase_count> phases;
+        Histogram request_bytes;
+        Histogram response_bytes;
+    };
+
+    struct Shard {
+        vector<Series> series;  // endpoint-major, one per algorithm label
+        vector<atomic<int64_t>> in_flight;  // per endpoint
+
+        Shard() : series(endpoints().size() * algorithms().size()), in_flight(endpoints().size()) {}
+    };
+
+    // Shards live as long as the process, so a scrape never sees one go away
+    // and the counts of finished threads are kept. A thread finds its shard
+    // through a thread_local, so there is one ServiceMetrics per process.
+    mutex registry_lock;
+    vector<unique_ptr<Shard>> shards;
+
+    Shard& localShard() {
+        thread_local Shard* shard = nullptr;
+        if (shard == nullptr) {
+            lock_guard<mutex> guard(registry_lock);
+            shards.push_back(make_unique<Shard>());
+            shard = shards.back().get();
+        }
+        return *shard;
+    }
+
+    // value / divisor in the shortest form that reads back as the same double,
+    // and integers in full
+    static string formatValue(uint64_t value, uint64_t divisor) {
+        if (divisor == 1) {
+            return to_string(value);
+        }
+        double scaled = static_cast<double>(value) / static_cast<double>(divisor);
+        char text[32];
+        for (int precision = 1; precision <= 17; precision++) {
+            snprintf(text, sizeof(text), "%.*g", precision, scaled);
+            if (strtod(text, nullptr) == scaled) {
+                break;
+            }
+        }
+        return text;
+    }
+
+    static size_t indexOf(const vector<string>& names, const string& name, size_t fallback) {
+        auto it = find(names.begin(), names.end(), name);
+        return it == names.end() ? fallback : static_cast<size_t>(it - names.begin());
+    }
+
+public:
+    // One request on the current thread, from the route's entry to its
+    // response. Handlers mark where parsing and scheduling end through the
+    // static note* functions; phases that were never reached are not
+    // recorded, so a cached response adds no schedule time.
+    class Request {
+    private:
+        Shard& shard;
+        size_t endpoint;
+        size_t algorithm;
+        size_t request_bytes;
+        chrono::steady_clock::time_point started;
+        chrono::steady_clock::time_point parsed;
+        chrono::steady_clock::time_point scheduled;
+        bool has_parsed = false;
+        bool has_scheduled = false;
+        Request* outer;
+
+        static Request*& current() {
+            thread_local Request* request = nullptr;
+            return request;
+        }
+
+        static uint64_t micros(chrono::steady_clock::duration duration) {
+            return static_cast<uint64_t>(chrono::duration_cast<chrono::microseconds>(duration).count());
+        }
+
+    public:
+        Request(ServiceMetrics& service_metrics, const string& endpoint_name, size_t body_bytes)
+            : shard(service_metrics.localShard()),
+              endpoint(indexOf(endpoints(), endpoint_name, 0)), algorithm(algorithms().size() - 1),
+              request_bytes(body_bytes), started(chrono::steady_clock::now()), outer(current()) {
+            add(shard.in_flight[endpoint], int64_t(1));
+            current() = this;
+        }
+
+        Request(const Request&) = delete;
+        Request& operator=(const Request&) = delete;
+
+        ~Request() {
+            current() = outer;
+        }
+
+        // Records the finished request with its status code and response size
+        void finish(int code, size_t response_bytes) {
+            auto finished = chrono::steady_clock::now();
+            Series& series = shard.series[endpoint * algorithms().size() + algorithm];
+            add(series.requests, uint64_t(1));
+            if (code >= 400) {
+                add(series.errors, uint64_t(1));
+            }
+            if (has_parsed) {
+                series.phases[Parse].record(micros(parsed - started));
+                if (has_scheduled) {
+                    series.phases[Schedule].record(micros(scheduled - parsed));
+                    series.phases[Serialize].record(micros(finished - scheduled));
+                }
+            }
+            series.request_bytes.record(request_bytes);
+            series.response_bytes.record(response_bytes);
+            add(shard.in_flight[endpoint], int64_t(-1));
+        }
+
+        static void noteAlgorithm(const string& name) {
+            if (current() != nullptr) {
+                current()->algorithm = indexOf(algorithms(), name, algorithms().size() - 1);
+            }
+        }
+
+        static void noteParsed() {
+            if (current() != nullptr && !current()->has_parsed) {
+                current()->parsed = chrono::steady_clock::now();
+                current()->has_parsed = true;
+            }
+        }
+
+        static void noteScheduled() {
+            if (current() != nullptr && current()->has_parsed && !current()->has_scheduled) {
+                current()->scheduled = chrono::steady_clock::now();
+                current()->has_scheduled = true;
+            }
+        }
+    };
+
+    // All series with at least one request, in the Prometheus text format
+    string exposition() {
+        vector<Shard*> snapshot;
+        {
+            lock_guard<mutex> guard(registry_lock);
+            for (const auto& shard : shards) {
+                snapshot.push_back(shard.get());
+            }
+        }
+
+        size_t series_count = endpoints().size() * algorithms().size();
+        auto labels = [](size_t index) {
+            size_t endpoint = index / algorithms().size();
+            size_t algorithm = index % algorithms().size();
+            return "endpoint=\"" + endpoints()[endpoint] + "\",algorithm=\"" + algorithms()[algorithm] + "\"";
+        };
+        auto total = [&](size_t index, atomic<uint64_t> Series::*counter) {
+            uint64_t sum = 0;
+            for (Shard* shard : snapshot) {
+                sum += (shard->series[index].*counter).load(memory_order_relaxed);
+            }
+            return sum;
+        };
+
+        vector<bool> active(series_count);
+        for (size_t i = 0; i < series_count; i++) {
+            active[i] = total(i, &Series::requests) > 0;
+        }
+
+        string out;
+        out += "# HELP scheduler_requests_total Requests handled.\n";
+        out += "# TYPE scheduler_requests_total counter\n";
+        for (size_t i = 0; i < series_count; i++) {
+            if (active[i]) {
+                out += "scheduler_requests_total{" + labels(i) + "} " + to_string(total(i, &Series::requests)) + "\n";
+            }
+        }
+        out += "# HELP scheduler_request_errors_total Requests answered with a 4xx or 5xx status.\n";
+        out += "# TYPE scheduler_request_errors_total counter\n";
+        for (size_t i = 0; i < series_count; i++) {
+            if (active[i]) {
+                out += "scheduler_request_errors_total{" + labels(i) + "} " + to_string(total(i, &Series::errors)) + "\n";
+            }
+        }
+
+        out += "# HELP scheduler_requests_in_flight Requests being handled.\n";
+        out += "# TYPE scheduler_requests_in_flight gauge\n";
+        for (size_t endpoint = 0; endpoint < endpoints().size(); endpoint++) {
+            int64_t sum = 0;
+            for (Shard* shard : snapshot) {
+                sum += shard->in_flight[endpoint].load(memory_order_relaxed);
+            }
+            out += "scheduler_requests_in_flight{endpoint=\"" + endpoints()[endpoint] + "\"} " + to_string(sum) + "\n";
+        }
+
+        // Adds the histogram of every active series, with bounds and sums
+        // divided by divisor (10^6 for microseconds as seconds)
+        auto histogram = [&](const string& name, const string& extra_label, uint64_t divisor,
+                             const function<const Histogram&(const Series&)>& pick) {
+            for (size_t i = 0; i < series_count; i++) {
+                if (!active[i]) {
+                    continue;
+                }
+                string series_labels = labels(i) + extra_label;
+                vector<uint64_t> counts(bounds().size() + 1, 0);
+                uint64_t sum = 0;
+                for (Shard* shard : snapshot) {
+                    const Histogram& h = pick(shard->series[i]);
+                    for (size_t bucket = 0; bucket < counts.size(); bucket++) {
+                        counts[bucket] += h.buckets[bucket].load(memory_order_relaxed);
+                    }
+                    sum += h.sum.load(memory_order_relaxed);
+                }
+
+                uint64_t cumulative = 0;
+                for (size_t bucket = 0; bucket < bounds().size(); bucket++) {
+                    cumulative += counts[bucket];
+                    out += name + "_bucket{" + series_labels + ",le=\"" + formatValue(bounds()[bucket], divisor) + "\"} " +
+                           to_string(cumulative) + "\n";
+                }
+                cumulative += counts.back();
+                out += name + "_bucket{" + series_labels + ",le=\"+Inf\"} " + to_string(cumulative) + "\n";
+                out += name + "_sum{" + series_labels + "} " + formatValue(sum, divisor) + "\n";
+                out += name + "_count{" + series_labels + "} " + to_string(cumulative) + "\n";
+            }
+        };
+
+        out += "# HELP scheduler_phase_seconds Time spent parsing, scheduling and serializing a request.\n";
+        out += "# TYPE scheduler_phase_seconds histogram\n";
+        const char* phase_names[phase_count] = {"parse", "schedule", "serialize"};
+        for (int phase = 0; phase < phase_count; phase++) {
+            histogram("scheduler_phase_seconds", string(",phase=\"") + phase_names[phase] + "\"", 1000000,
+                      [phase](const Series& s) -> const Histogram& { return s.phases[phase]; });
+        }
+        out += "# HELP scheduler_request_bytes Request body sizes.\n";
+        out += "# TYPE scheduler_request_bytes histogram\n";
+        histogram("scheduler_request_bytes", "", 1, [](const Series& s) -> const Histogram& { return s.request_bytes; });
+        out += "# HELP scheduler_response_bytes Response body sizes.\n";
+        out += "# TYPE scheduler_response_bytes histogram\n";
+        histogram("scheduler_response_bytes", "", 1, [](const Series& s) -> const Histogram& { return s.response_bytes; });
+        return out;
+    }
+};
+
+#endif
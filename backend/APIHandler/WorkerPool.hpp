@@ -0,0 +1,82 @@
+#ifndef WORKER_POOL_HPP
+#define WORKER_POOL_HPP
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Fixed set of threads for CPU-bound scheduling work, kept apart from the
+// server's I/O threads so a large batch cannot starve request handling.
+// Tasks run in submission order; submit() returns a future that yields the
+// task's result or rethrows its exception.
+class WorkerPool {
+private:
+    vector<thread> workers;
+    deque<function<void()>> tasks;
+    mutex lock;
+    condition_variable available;
+    bool stopping = false;
+
+    void work() {
+        while (true) {
+            function<void()> task;
+            {
+                unique_lock<mutex> guard(lock);
+                available.wait(guard, [&] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) {
+                    return;
+                }
+                task = move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+public:
+    explicit WorkerPool(unsigned threads = max(1u, thread::hardware_concurrency())) {
+        for (unsigned i = 0; i < threads; i++) {
+            workers.emplace_back([this] { work(); });
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        available.notify_all();
+        for (thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    size_t size() const {
+        return workers.size();
+    }
+
+    template <typename Task>
+    auto submit(Task task) -> future<decltype(task())> {
+        auto packaged = make_shared<packaged_task<decltype(task())()>>(move(task));
+        auto result = packaged->get_future();
+        {
+            lock_guard<mutex> guard(lock);
+            tasks.emplace_back([packaged] { (*packaged)(); });
+        }
+        available.notify_one();
+        return result;
+    }
+};
+
+#endif
@@ -0,0 +1,190 @@
+#ifndef WORKLOAD_GENERATOR_HPP
+#define WORKLOAD_GENERATOR_HPP
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "json.hpp"
+#include "Type.hpp"
+using namespace std;
+
+// Parameters of a synthetic workload. Every field has a default, so a spec
+// only needs to name what it changes.
+struct WorkloadSpec {
+    uint64_t seed = 1;
+    size_t count = 1000;
+
+    // "poisson": exponential gaps between arrivals. "bursty": groups of
+    // processes arrive together, with a geometric group size of mean
+    // group_size and Poisson group arrivals; the long-run rate is the same.
+    string arrivals = "poisson";
+    double arrival_rate = 1.0;  // processes per time unit
+    double group_size = 8.0;
+
+    // "exponential", "lognormal" (shape sigma) or "pareto" (shape alpha),
+    // all scaled to burst_mean, rounded and kept within [1, max_burst]
+    string bursts = "exponential";
+    double burst_mean = 10.0;
+    double sigma = 1.0;
+    double alpha = 2.0;
+    int max_burst = 1000000;
+
+    // Relative weight of priority 0, 1, ...
+    vector<double> priority_weights = {1.0};
+};
+
+// Generates reproducible workloads from a WorkloadSpec. Random numbers come
+// from mt19937_64, whose output is fixed by the standard, and every
+// distribution is derived here from its raw bits rather than taken from
+// <random>, whose distributions differ between standard libraries. The same
+// seed therefore gives the same processes on every build, up to the last bit
+// of the platform's log and exp.
+class WorkloadGenerator {
+private:
+    WorkloadSpec spec;
+    mt19937_64 engine;
+    vector<double> priority_cumulative;
+
+    // Uniform on (0, 1]
+    double uniform() {
+        return (static_cast<double>(engine() >> 11) + 1.0) * 0x1.0p-53;
+    }
+
+    double exponential(double mean) {
+        return -mean * log(uniform());
+    }
+
+    // Standard normal, Box-Muller
+    double normal() {
+        double radius = sqrt(-2.0 * log(uniform()));
+        const double pi = 3.14159265358979323846;
+        return radius * cos(2.0 * pi * uniform());
+    }
+
+    double burstLength() {
+        if (spec.bursts == "lognormal") {
+            double mu = log(spec.burst_mean) - spec.sigma * spec.sigma / 2.0;
+            return exp(mu + spec.sigma * normal());
+        }
+        if (spec.bursts == "pareto") {
+            // Scale chosen so the mean is burst_mean where it exists (alpha > 1)
+            double scale = spec.alpha > 1.0 ? spec.burst_mean * (spec.alpha - 1.0) / spec.alpha : spec.burst_mean;
+            return scale / pow(uniform(), 1.0 / spec.alpha);
+        }
+        return exponential(spec.burst_mean);
+    }
+
+    int priority() {
+        // First level whose cumulative weight reaches the pick
+        double pick = uniform() * priority_cumulative.back();
+        auto level = lower_bound(priority_cumulative.begin(), priority_cumulative.end(), pick);
+        if (level == priority_cumulative.end()) {
+            return static_cast<int>(priority_cumulative.size()) - 1;
+        }
+        return static_cast<int>(level - priority_cumulative.begin());
+    }
+
+    static void validate(const WorkloadSpec& spec) {
+        if (spec.count == 0) {
+            throw invalid_argument("count must be positive");
+        }
+        if (spec.arrivals != "poisson" && spec.arrivals != "bursty") {
+            throw invalid_argument("arrivals must be \"poisson\" or \"bursty\"");
+        }
+        if (spec.bursts != "exponential" && spec.bursts != "lognormal" && spec.bursts != "pareto") {
+            throw invalid_argument("bursts must be \"exponential\", \"lognormal\" or \"pareto\"");
+        }
+        if (!(spec.arrival_rate > 0.0) || !(spec.group_size >= 1.0 && isfinite(spec.group_size)) ||
+            !(spec.burst_mean > 0.0) || !(spec.sigma > 0.0) || !(spec.alpha > 0.0) || spec.max_burst < 1) {
+            throw invalid_argument("arrival_rate, burst_mean, sigma and alpha must be positive, "
+                                   "group_size and max_burst at least 1");
+        }
+        double total_weight = 0.0;
+        for (double weight : spec.priority_weights) {
+            if (!(weight >= 0.0)) {
+                throw invalid_argument("priority_weights must not be negative");
+            }
+            total_weight += weight;
+        }
+        if (!(total_weight > 0.0)) {
+            throw invalid_argument("priority_weights must have a positive sum");
+        }
+    }
+
+public:
+    explicit WorkloadGenerator(const WorkloadSpec& workload_spec) : spec(workload_spec), engine(workload_spec.seed) {
+        validate(spec);
+        double sum = 0.0;
+        for (double weight : spec.priority_weights) {
+            sum += weight;
+            priority_cumulative.push_back(sum);
+        }
+    }
+
+    // Processes with ids 1..count in arrival order. Throws
+    // std::invalid_argument if the schedule could outgrow int: the last
+    // arrival plus the total burst bounds every completion time.
+    vector<Process> generate() {
+        vector<Process> processes;
+        processes.reserve(spec.count);
+
+        double clock = 0.0;
+        double total_burst = 0.0;
+        size_t group_left = 0;
+        // A geometric group of mean g ends after each member with probability 1/g
+        double group_rate = spec.arrival_rate / spec.group_size;
+        double group_log = log1p(-1.0 / spec.group_size);
+        for (size_t i = 0; i < spec.count; i++) {
+            if (spec.arrivals == "poisson") {
+                clock += exponential(1.0 / spec.arrival_rate);
+            } else if (group_left == 0) {
+                clock += exponential(1.0 / group_rate);
+                // Inverse of the geometric distribution, capped at the processes left
+                double size = 1.0 + floor(log(uniform()) / group_log);
+                group_left = static_cast<size_t>(min(size, static_cast<double>(spec.count - i)));
+            }
+            if (group_left > 0) {
+                group_left--;
+            }
+            double burst = round(burstLength());
+            burst = min(max(burst, 1.0), static_cast<double>(spec.max_burst));
+            total_burst += burst;
+            if (clock + total_burst > INT32_MAX) {
+                throw invalid_argument("The schedule could exceed the int time range; raise arrival_rate "
+                                       "or lower count or burst_mean");
+            }
+
+            Process p;
+            p.p_id = static_cast<int>(i + 1);
+            p.arrival_time = static_cast<int>(clock);
+            p.burst_time = static_cast<int>(burst);
+            p.priority = priority();
+            processes.push_back(p);
+        }
+        return processes;
+    }
+
+    // Reads a spec from a JSON object with the WorkloadSpec field names
+    static WorkloadSpec specFromJson(const nlohmann::json& input) {
+        WorkloadSpec spec;
+        spec.seed = input.value("seed", spec.seed);
+        spec.count = input.value("count", spec.count);
+        spec.arrivals = input.value("arrivals", spec.arrivals);
+        spec.arrival_rate = input.value("arrival_rate", spec.arrival_rate);
+        spec.group_size = input.value("group_size", spec.group_size);
+        spec.bursts = input.value("bursts", spec.bursts);
+        spec.burst_mean = input.value("burst_mean", spec.burst_mean);
+        spec.sigma = input.value("sigma", spec.sigma);
+        spec.alpha = input.value("alpha", spec.alpha);
+        spec.max_burst = input.value("max_burst", spec.max_burst);
+        spec.priority_weights = input.value("priority_weights", spec.priority_weights);
+        return spec;
+    }
+};
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef AGING_READY_QUEUE_HPP
+#define AGING_READY_QUEUE_HPP
+#pragma once
+#include <vector>
+#include <queue>
+#include <climits>
+#include <algorithm>
+#include <functional>
+#include "ScratchArena.hpp"
+
+using namespace std;
+
+// Waiting processes for SJF with aging.
+//
+// A process's aged time is its remaining burst minus aging_threshold / 100 per
+// tick waited, floored at 0.5. All values are kept in hundredths of a time unit
+// so the arithmetic is exact integer math on every platform.
+//
+// Aging is linear in time: a process that started waiting at time t0 with w0
+// ticks already credited has, at time t,
+//     aged = 100 * remaining - threshold * (w0 + t - t0)
+//          = (100 * remaining - threshold * (w0 - t0)) - threshold * t
+// The bracketed value is fixed when the process is pushed and the last term is
+// shared by every waiting process, so ordering them by that value never goes
+// stale. Processes that have hit the floor all tie at 0.5 and are ordered by
+// arrival instead; they move to a second heap as time passes. Nothing is
+// touched between pushes and pops.
+class AgingReadyQueue {
+public:
+    static constexpr long long SCALE = 100;  // hundredths of a time unit
+    static constexpr long long FLOOR = 50;   // 0.5 time units
+
+    static long long agedTime(long long remaining, long long waited, int aging_threshold) {
+        return max(remaining * SCALE - aging_threshold * waited, FLOOR);
+    }
+
+private:
+    int aging_threshold;
+    priority_queue<pair<long long, int>, pmr::vector<pair<long long, int>>, greater<pair<long long, int>>> aging;
+    priority_queue<int, pmr::vector<int>, greater<int>> floored;
+
+    // Moves every process whose aged time has reached the floor by now
+    void settle(int now) {
+        if (aging_threshold <= 0) {
+            return;  // aged times never fall
+        }
+        while (!aging.empty() && aging.top().first - static_cast<long long>(aging_threshold) * now <= FLOOR) {
+            floored.push(aging.top().second);
+            aging.pop();
+        }
+    }
+
+public:
+    explicit AgingReadyQueue(int threshold)
+        : aging_threshold(threshold), aging(scratchResource()), floored(scratchResource()) {}
+
+    bool empty() const {
+        return aging.empty() && floored.empty();
+    }
+
+    // Adds a process that has waited `waited` ticks so far and waits from `now` on.
+    void push(int index, int remaining, int waited, int now) {
+        long long base = remaining * SCALE - static_cast<long long>(aging_threshold) * (waited - static_cast<long long>(now));
+        aging.push({base, index});
+    }
+
+    // Best waiting process at time now, as (aged time, index). Ties on aged
+    // time go to the earlier arrival, i.e. the lower index.
+    pair<long long, int> top(int now) {
+        settle(now);
+        if (!floored.empty()) {
+            return {FLOOR, floored.top()};
+        }
+        return {aging.top().first - static_cast<long long>(aging_threshold) * now, aging.top().second};
+    }
+
+    int pop(int now) {
+        settle(now);
+        int index;
+        if (!floored.empty()) {
+            index = floored.top();
+            floored.pop();
+        } else {
+            index = aging.top().second;
+            aging.pop();
+        }
+        return index;
+    }
+
+    // True if some waiting process is still above the floor at time now.
+    bool hasUnfloored(int now) {
+        settle(now);
+        return !aging.empty();
+    }
+
+    // Best waiting process that is still above the floor, as (aged time, index).
+    pair<long long, int> unflooredTop(int now) {
+        settle(now);
+        return {aging.top().first - static_cast<long long>(aging_threshold) * now, aging.top().second};
+    }
+
+    // Ticks from now until the next waiting process reaches the floor, or INT_MAX.
+    int ticksUntilFloor(int now) {
+        if (aging_threshold <= 0 || !hasUnfloored(now)) {
+            return INT_MAX;
+        }
+        long long above_floor = unflooredTop(now).first - FLOOR;
+        long long ticks = (above_floor + aging_threshold - 1) / aging_threshold;
+        return static_cast<int>(min(ticks, static_cast<long long>(INT_MAX)));
+    }
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef ARRIVAL_ORDER_HPP
+#define ARRIVAL_ORDER_HPP
+#pragma once
+#include <algorithm>
+#include <vector>
+#include "../Type.hpp"
+
+using namespace std;
+
+// A workload sorted by arrival time, the order every scheduler works in.
+// Sorting once and passing the same read-only view to several schedulers
+// saves each of them its own copy and sort.
+class ArrivalOrder {
+private:
+    vector<Process> sorted;
+
+public:
+    explicit ArrivalOrder(vector<Process> processes) : sorted(move(processes)) {
+        sort(sorted.begin(), sorted.end(), [](const Process& a, const Process& b) {
+            return a.arrival_time < b.arrival_time;
+        });
+    }
+
+    const vector<Process>& processes() const {
+        return sorted;
+    }
+};
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef EVENT_ENGINE_HPP
+#define EVENT_ENGINE_HPP
+#pragma once
+#include <vector>
+#include <climits>
+#include "../Type.hpp"
+#include "ScratchArena.hpp"
+
+using namespace std;
+
+// Discrete-event clock shared by the preemptive schedulers.
+//
+// Instead of advancing time one unit per loop iteration, a scheduler asks how
+// long its current decision is guaranteed to hold (until the next arrival,
+// a completion, a quantum expiry or an aging deadline) and advances the clock
+// over that whole stretch at once. The cost of a run then grows with the number
+// of scheduling events rather than with the total burst time.
+class EventEngine {
+private:
+    const vector<Process>& processes;  // sorted by arrival time
+    int current_time;
+    int arrived;   // processes[0, arrived) have arrival_time <= current_time
+    int admitted;  // processes[0, admitted) have been handed out by admitArrivals()
+
+    // Arrived, unfinished processes as a doubly linked list in arrival order,
+    // with node n as the sentinel, so snapshots skip finished processes
+    pmr::vector<int> next_active;
+    pmr::vector<int> prev_active;
+
+    void catchUp() {
+        int sentinel = static_cast<int>(processes.size());
+        while (arrived < sentinel && processes[arrived].arrival_time <= current_time) {
+            int last = prev_active[sentinel];
+            next_active[last] = arrived;
+            prev_active[arrived] = last;
+            next_active[arrived] = sentinel;
+            prev_active[sentinel] = arrived;
+            arrived++;
+        }
+    }
+
+public:
+    explicit EventEngine(const vector<Process>& sorted_processes, int start_time = 0)
+        : processes(sorted_processes), current_time(start_time), arrived(0), admitted(0),
+          next_active(sorted_processes.size() + 1, scratchResource()),
+          prev_active(sorted_processes.size() + 1, scratchResource()) {
+        int sentinel = static_cast<int>(processes.size());
+        next_active[sentinel] = prev_active[sentinel] = sentinel;
+        catchUp();
+    }
+
+    int now() const {
+        return current_time;
+    }
+
+    // Number of processes that have arrived by now. Because the input is sorted,
+    // they are always the prefix [0, arrivedCount()) of the process list.
+    int arrivedCount() const {
+        return arrived;
+    }
+
+    // True if at least one process arrives exactly at the current time.
+    bool arrivalAtNow() const {
+        return arrived > 0 && processes[arrived - 1].arrival_time == current_time;
+    }
+
+    int nextArrivalTime() const {
+        return arrived < static_cast<int>(processes.size()) ? processes[arrived].arrival_time : INT_MAX;
+    }
+
+    // Ticks until the next arrival, or INT_MAX if every process has arrived.
+    int ticksUntilNextArrival() const {
+        return arrived < static_cast<int>(processes.size()) ? processes[arrived].arrival_time - current_time : INT_MAX;
+    }
+
+    // Ticks until admitArrivals() has a process to hand out: zero if some
+    // have already arrived, otherwise the ticks until the next arrival.
+    int ticksUntilNextAdmission() const {
+        return admitted < arrived ? 0 : ticksUntilNextArrival();
+    }
+
+    // Calls on_arrival(index) once for every process that has arrived by now,
+    // in arrival order, skipping those already handed out.
+    template <typename OnArrival>
+    void admitArrivals(OnArrival on_arrival) {
+        while (admitted < arrived) {
+            on_arrival(admitted++);
+        }
+    }
+
+    // Removes a completed process from the active list.
+    void finish(int index) {
+        next_active[prev_active[index]] = next_active[index];
+        prev_active[next_active[index]] = prev_active[index];
+    }
+
+    // Calls visit(index) for every arrived, unfinished process in arrival order.
+    template <typename Visit>
+    void forEachActive(Visit visit) const {
+        int sentinel = static_cast<int>(processes.size());
+        for (int i = next_active[sentinel]; i != sentinel; i = next_active[i]) {
+            visit(i);
+        }
+    }
+
+    void advance(int ticks) {
+        current_time += ticks;
+        catchUp();
+    }
+
+    void jumpTo(int time) {
+        current_time = time;
+        catchUp();
+    }
+};
+
+#endif
@@ -6,16 +6,22 @@
 #include <algorithm>
 #include <queue>
 #include <climits>
+#include <deque>
+#include <cstdint>
 #include "../Type.hpp"
 #include "../json.hpp"
+#include "EventEngine.hpp"
+#include "OutputSink.hpp"
+#include "ArrivalOrder.hpp"
+#include "ScratchArena.hpp"
 
 using namespace std;
 using json = nlohmann::json;
 
 class MLFQ {
 private:
-    int num_queues;
     int base_time_slice;
+    int num_queues;
     
     int getTimeSliceForQueue(int queue_level) {
         if (queue_level == num_queues - 1) {
@@ -27,105 +33,172 @@ private:
 public:
     MLFQ(int time_slice = 2, int num_of_queues = 3) : base_time_slice(time_slice), num_queues(num_of_queues) {}
     
-    json schedule(const vector<Process>& processes) {
-        vector<json> gantt_chart;
-        vector<json> process_stats;
+    ScheduleLayout layout() const {
+        return {ReadyLayout::LevelMap, num_queues, "final_queue_level", false};
+    }
+    
+    template <typename Sink>
+    void schedule(const vector<Process>& processes, Sink& sink) {
+        schedule(ArrivalOrder(processes), sink);
+    }
+
+    template <typename Sink>
+    void schedule(const ArrivalOrder& workload, Sink& sink) {
+        if (num_queues <= 0) {
+            sink.fail("Invalid number of queues");
+            return;
+        }
+        sink.begin(layout());
         
-        vector<Process> sorted_processes = processes;
-        sort(sorted_processes.begin(), sorted_processes.end(), [](const Process& a, const Process& b) {
-            return a.arrival_time < b.arrival_time;
-        });
+        const vector<Process>& sorted_processes = workload.processes();
         
         int n = sorted_processes.size();
-        vector<int> remaining_burst_time(n);
-        vector<bool> is_completed(n, false);
-        vector<int> queue_level(n, 0); 
-        vector<int> time_in_current_slice(n, 0);
+        pmr::vector<int> remaining_burst_time(n, scratchResource());
+        pmr::vector<int> queue_level(n, 0, scratchResource()); 
+        pmr::vector<int> time_in_current_slice(n, 0, scratchResource());
         
         for (int i = 0; i < n; i++) {
             remaining_burst_time[i] = sorted_processes[i].burst_time;
         }
         
-        int current_time = 0;
-        int completed = 0;
-        int last_process_id = -1;
+        // One FIFO run queue per level. A process stays at the front of its
+        // queue while it runs, including when an arrival interrupts it, and
+        // leaves only on demotion or completion. Processes therefore enter and
+        // leave every level in arrival order, so the front of the highest
+        // non-empty level is always the process to run next.
+        pmr::vector<pmr::deque<int>> run_queues(num_queues, scratchResource());
+        pmr::vector<uint64_t> level_bits((num_queues + 63) / 64, 0, scratchResource());  // bit q set if run_queues[q] is non-empty
+        pmr::vector<int> pushes(num_queues, 0, scratchResource());  // per level: pushes so far, the next order key
+        pmr::vector<int> queue_order(n, 0, scratchResource());      // order key of each process in its level
+        int left_out = -1;  // the process the latest row runs, not shown as waiting
         
-        while (completed < n) {
-            int selected_index = -1;
-            int highest_priority_queue = num_queues; 
-            
-            for (int i = 0; i < n; i++) {
-                if (!is_completed[i] && sorted_processes[i].arrival_time <= current_time) {
-                    if (queue_level[i] < highest_priority_queue) {
-                        highest_priority_queue = queue_level[i];
-                        selected_index = i;
-                    }
+        auto enqueue = [&](int level, int index) {
+            run_queues[level].push_back(index);
+            level_bits[level / 64] |= 1ULL << (level % 64);
+            countQueueOperation(sink);
+            queue_order[index] = pushes[level]++;
+            if (index != left_out) {
+                sink.enqueued(index, sorted_processes[index].p_id, level, queue_order[index]);
+            }
+        };
+        
+        auto dequeue = [&](int level) {
+            sink.dequeued(run_queues[level].front());
+            run_queues[level].pop_front();
+            countQueueOperation(sink);
+            if (run_queues[level].empty()) {
+                level_bits[level / 64] &= ~(1ULL << (level % 64));
+            }
+        };
+        
+        auto highestLevel = [&]() {
+            for (int word = 0; word < static_cast<int>(level_bits.size()); word++) {
+                if (level_bits[word] != 0) {
+                    return word * 64 + __builtin_ctzll(level_bits[word]);
                 }
             }
-            
-            if (selected_index == -1) {
-                if (last_process_id != -1) {
-                    gantt_chart.back()["end_time"] = current_time;
+            return -1;
+        };
+        
+        // Gantt chart entry with every waiting process by level, leaving out
+        // the running one (always the front of its own level)
+        auto startSegment = [&](int running_index, int start_time) {
+            if (left_out != running_index) {
+                // A process still queued when it stops running is back at the front of its level
+                if (left_out != -1 && remaining_burst_time[left_out] > 0) {
+                    sink.enqueued(left_out, sorted_processes[left_out].p_id, queue_level[left_out],
+                                  queue_order[left_out]);
                 }
-                
-                json queue_status;
+                sink.dequeued(running_index);
+                left_out = running_index;
+            }
+            sink.segment(sorted_processes[running_index].p_id, start_time, queue_level[running_index]);
+            if (sink.wantsReadyLists()) {
+                sink.levelSnapshot();
                 for (int q = 0; q < num_queues; q++) {
-                    queue_status[to_string(q)] = json::array();
+                    for (int index : run_queues[q]) {
+                        if (index != running_index) {
+                            sink.queued(q, sorted_processes[index].p_id);
+                        }
+                    }
                 }
-                
-                gantt_chart.push_back({
-                    {"process_id", -1},
-                    {"start_time", current_time},
-                    {"queue_level", -1},
-                    {"ready_queues", queue_status}
-                });
-                
-                last_process_id = -1;
-                current_time++;
-                continue;
             }
+        };
+        
+        int completed = 0;
+        int last_index = -1;
+        EventEngine engine(sorted_processes);
+        
+        while (completed < n) {
+            int current_time = engine.now();
+            engine.admitArrivals([&](int index) {
+                enqueue(0, index);
+            });
             
-            if (last_process_id != sorted_processes[selected_index].p_id) {
-                if (last_process_id != -1) {
-                    gantt_chart.back()["end_time"] = current_time;
+            int highest_priority_queue = highestLevel();
+            
+            if (highest_priority_queue == -1) {
+                if (last_index != -1) {
+                    sink.endSegment(current_time);
                 }
                 
-                json queue_status;
-                for (int q = 0; q < num_queues; q++) {
-                    queue_status[to_string(q)] = json::array();
+                // Idle time is reported as one entry per time unit
+                int next_arrival = engine.nextArrivalTime();
+                for (int idle_time = current_time; idle_time < next_arrival; idle_time++) {
+                    sink.segment(-1, idle_time, -1);
+                    if (sink.wantsReadyLists()) {
+                        sink.levelSnapshot();
+                    }
                 }
                 
-                for (int i = 0; i < n; i++) {
-                    if (!is_completed[i] && sorted_processes[i].arrival_time <= current_time && i != selected_index) {
-                        queue_status[to_string(queue_level[i])].push_back(sorted_processes[i].p_id);
-                    }
+                last_index = -1;
+                engine.jumpTo(next_arrival);
+                continue;
+            }
+            
+            int selected_index = run_queues[highest_priority_queue].front();
+            countSelection(sink);
+            
+            if (last_index != selected_index) {
+                if (last_index != -1) {
+                    sink.endSegment(current_time);
                 }
                 
-                gantt_chart.push_back({
-                    {"process_id", sorted_processes[selected_index].p_id},
-                    {"start_time", current_time},
-                    {"queue_level", queue_level[selected_index]},
-                    {"ready_queues", queue_status}
-                });
+                startSegment(selected_index, current_time);
                 
-                last_process_id = sorted_processes[selected_index].p_id;
+                last_index = selected_index;
             }
             
-            remaining_burst_time[selected_index]--;
-            time_in_current_slice[selected_index]++;
-            current_time++;
-            
+            // Run until the next arrival, completion or the end of the time slice
             int current_time_slice = getTimeSliceForQueue(queue_level[selected_index]);
-            if (time_in_current_slice[selected_index] >= current_time_slice && queue_level[selected_index] < num_queues - 1) {
+            int run_time = min(remaining_burst_time[selected_index], engine.ticksUntilNextArrival());
+            if (queue_level[selected_index] < num_queues - 1) {
+                run_time = min(run_time, max(current_time_slice - time_in_current_slice[selected_index], 1));
+            }
+            
+            remaining_burst_time[selected_index] -= run_time;
+            time_in_current_slice[selected_index] += run_time;
+            engine.advance(run_time);
+            current_time = engine.now();
+            
+            bool slice_expired = time_in_current_slice[selected_index] >= current_time_slice && queue_level[selected_index] < num_queues - 1;
+            bool finished = remaining_burst_time[selected_index] == 0;
+            if (slice_expired || finished) {
+                dequeue(queue_level[selected_index]);
+            }
+            
+            if (slice_expired) {
                 queue_level[selected_index]++;
                 time_in_current_slice[selected_index] = 0;
+                if (!finished) {
+                    enqueue(queue_level[selected_index], selected_index);
+                }
                 
-                gantt_chart.back()["end_time"] = current_time;
-                last_process_id = -1;
+                sink.endSegment(current_time);
+                last_index = -1;
             }
             
-            if (remaining_burst_time[selected_index] == 0) {
-                is_completed[selected_index] = true;
+            if (finished) {
                 completed++;
                 
                 time_in_current_slice[selected_index] = 0;
@@ -134,68 +207,32 @@ public:
                 int turnaround_time = completion_time - sorted_processes[selected_index].arrival_time;
                 int waiting_time = turnaround_time - sorted_processes[selected_index].burst_time;
                 
-                process_stats.push_back({
-                    {"process_id", sorted_processes[selected_index].p_id},
-                    {"arrival_time", sorted_processes[selected_index].arrival_time},
-                    {"burst_time", sorted_processes[selected_index].burst_time},
-                    {"priority", sorted_processes[selected_index].priority},
-                    {"completion_time", completion_time},
-                    {"turnaround_time", turnaround_time},
-                    {"waiting_time", waiting_time},
-                    {"final_queue_level", queue_level[selected_index]}
-                });
+                sink.stat({sorted_processes[selected_index].p_id, sorted_processes[selected_index].arrival_time,
+                           sorted_processes[selected_index].burst_time, sorted_processes[selected_index].priority,
+                           completion_time, turnaround_time, waiting_time, queue_level[selected_index], 0});
                 
-                gantt_chart.back()["end_time"] = current_time;
-                last_process_id = -1;
+                sink.endSegment(current_time);
+                last_index = -1;
             }
             
-            for (int i = 0; i < n; i++) {
-                if (sorted_processes[i].arrival_time == current_time) {
-                    if (last_process_id != -1) {
-                        gantt_chart.back()["end_time"] = current_time;
-                        
-                        int running_index = -1;
-                        for (int j = 0; j < n; j++) {
-                            if (sorted_processes[j].p_id == last_process_id) {
-                                running_index = j;
-                                break;
-                            }
-                        }
-                        
-                        if (running_index != -1) {
-                            json queue_status;
-                            for (int q = 0; q < num_queues; q++) {
-                                queue_status[to_string(q)] = json::array();
-                            }
-                            
-                            for (int j = 0; j < n; j++) {
-                                if (!is_completed[j] && sorted_processes[j].arrival_time <= current_time && 
-                                    sorted_processes[j].p_id != last_process_id) {
-                                    queue_status[to_string(queue_level[j])].push_back(sorted_processes[j].p_id);
-                                }
-                            }
-                            
-                            gantt_chart.push_back({
-                                {"process_id", last_process_id},
-                                {"start_time", current_time},
-                                {"queue_level", queue_level[running_index]},
-                                {"ready_queues", queue_status}
-                            });
-                        }
-                    }
-                    break;
-                }
+            if (engine.arrivalAtNow() && last_index != -1) {
+                sink.endSegment(current_time);
+                
+                engine.admitArrivals([&](int index) {
+                    enqueue(0, index);
+                });
+                
+                startSegment(last_index, current_time);
             }
         }
         
-        if (!gantt_chart.empty()) {
-            gantt_chart.back()["end_time"] = current_time;
-        }
-        
-        json result;
-        result["gantt_chart"] = gantt_chart;
-        result["process_stats"] = process_stats;
-        return result;
+        sink.endSegment(engine.now());
+    }
+    
+    json schedule(const vector<Process>& processes) {
+        JsonSink sink;
+        schedule(processes, sink);
+        return sink.result();
     }
 };
 
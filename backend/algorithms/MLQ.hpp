@@ -8,42 +8,44 @@
 #include <climits>
 #include "../Type.hpp"
 #include "../json.hpp"
+#include "OutputSink.hpp"
+#include "ArrivalOrder.hpp"
+#include "ScratchArena.hpp"
 
 using namespace std;
 using json = nlohmann::json;
 
 class MLQ {
 public:
-    json schedule(const vector<Process>& processes, int num_queues, int base_quantum) {
+    static ScheduleLayout layout(int num_queues) {
+        return {ReadyLayout::Levels, num_queues, "queue", false};
+    }
+
+    template <typename Sink>
+    void schedule(const vector<Process>& processes, int num_queues, int base_quantum, Sink& sink) {
+        schedule(ArrivalOrder(processes), num_queues, base_quantum, sink);
+    }
+
+    template <typename Sink>
+    void schedule(const ArrivalOrder& workload, int num_queues, int base_quantum, Sink& sink) {
         // Validate input
         if (num_queues <= 0 || base_quantum <= 0) {
-            return json({
-                {"status", "error"},
-                {"message", "Invalid number of queues or base quantum"}
-            });
+            sink.fail("Invalid number of queues or base quantum");
+            return;
         }
+        sink.begin(layout(num_queues));
 
-        // Create the result JSON
-        json result;
-        vector<json> gantt_chart;
-        vector<json> process_stats;
-
-        // Sort processes by arrival time
-        vector<Process> sorted_processes = processes;
-        sort(sorted_processes.begin(), sorted_processes.end(), [](const Process& a, const Process& b) {
-            return a.arrival_time < b.arrival_time;
-        });
+        // Processes in arrival order
+        const vector<Process>& sorted_processes = workload.processes();
 
         int n = sorted_processes.size();
         if (n == 0) {
-            result["gantt_chart"] = gantt_chart;
-            result["process_stats"] = process_stats;
-            return result;
+            return;
         }
 
         // Create queues for the MLQ
-        vector<deque<int>> queues(num_queues);
-        vector<int> time_quanta(num_queues);
+        pmr::vector<pmr::deque<int>> queues(num_queues, scratchResource());
+        pmr::vector<int> time_quanta(num_queues, scratchResource());
         
         // Set the time quantum for each queue
         for (int i = 0; i < num_queues; i++) {
@@ -51,10 +53,12 @@ public:
         }
 
         // Initialize process tracking variables
-        vector<int> remaining_burst_time(n);
-        vector<bool> is_completed(n, false);
-        vector<int> completion_time(n, 0);
-        vector<int> queue_assignment(n, 0); // Which queue each process is assigned to
+        pmr::vector<int> remaining_burst_time(n, scratchResource());
+        pmr::vector<bool> is_completed(n, false, scratchResource());
+        pmr::vector<int> completion_time(n, 0, scratchResource());
+        pmr::vector<int> queue_assignment(n, 0, scratchResource()); // Which queue each process is assigned to
+        pmr::vector<bool> in_queue(n, false, scratchResource());
+        pmr::vector<int> pushes(num_queues, 0, scratchResource());  // per queue: pushes so far, the next order key
         
         for (int i = 0; i < n; i++) {
             remaining_burst_time[i] = sorted_processes[i].burst_time;
@@ -67,29 +71,40 @@ public:
         int current_process_id = -1;
         int last_process_id = -1;
         int time_in_current_process = 0;
+        int next_arrival = 0; // Processes before this index in sorted order have been admitted
+        bool segment_open = false; // The latest Gantt chart entry has no end time yet
+
+        // Queue a process unless it is already waiting in its queue
+        auto enqueue = [&](int i) {
+            if (!in_queue[i]) {
+                queues[queue_assignment[i]].push_back(i);
+                in_queue[i] = true;
+                countQueueOperation(sink);
+                sink.enqueued(i, sorted_processes[i].p_id, queue_assignment[i], pushes[queue_assignment[i]]++);
+            }
+        };
+
+        // Admit every process that has arrived by current_time; returns true if any did
+        auto admitArrivals = [&]() {
+            bool admitted = false;
+            while (next_arrival < n && sorted_processes[next_arrival].arrival_time <= current_time) {
+                enqueue(next_arrival++);
+                admitted = true;
+            }
+            return admitted;
+        };
 
         // Start with an idle slot if no process arrives at time 0
         if (sorted_processes[0].arrival_time > 0) {
-            json idle_slot = {
-                {"process_id", -1},
-                {"start_time", 0},
-                {"end_time", sorted_processes[0].arrival_time},
-                {"queues", json::array()},
-                {"queue_level", -1}  // Indicate no queue is running
-            };
-            gantt_chart.push_back(idle_slot);
+            sink.segment(-1, 0, -1);  // Queue level -1: no queue is running
+            sink.endSegment(sorted_processes[0].arrival_time);
             current_time = sorted_processes[0].arrival_time;
         }
 
         // Main scheduling loop
         while (completed < n) {
             // Check for new arrivals and add them to appropriate queues
-            for (int i = 0; i < n; i++) {
-                if (!is_completed[i] && sorted_processes[i].arrival_time <= current_time && 
-                    find(queues[queue_assignment[i]].begin(), queues[queue_assignment[i]].end(), i) == queues[queue_assignment[i]].end()) {
-                    queues[queue_assignment[i]].push_back(i);
-                }
-            }
+            admitArrivals();
 
             // Find the highest priority non-empty queue
             int active_queue = -1;
@@ -103,32 +118,20 @@ public:
             // If all queues are empty but not all processes have arrived
             if (active_queue == -1) {
                 // Find the next arriving process
-                int next_arrival_time = INT_MAX;
-                for (int i = 0; i < n; i++) {
-                    if (!is_completed[i] && sorted_processes[i].arrival_time > current_time &&
-                        sorted_processes[i].arrival_time < next_arrival_time) {
-                        next_arrival_time = sorted_processes[i].arrival_time;
-                    }
-                }
-
-                if (next_arrival_time == INT_MAX) {
+                if (next_arrival == n) {
                     // All processes have completed
                     break;
                 }
+                int next_arrival_time = sorted_processes[next_arrival].arrival_time;
 
                 // Add idle slot to gantt chart
                 if (last_process_id != -1) {
-                    gantt_chart.back()["end_time"] = current_time;
+                    sink.endSegment(current_time);
                 }
 
-                json idle_slot = {
-                    {"process_id", -1},
-                    {"start_time", current_time},
-                    {"end_time", next_arrival_time},
-                    {"queues", json::array()},
-                    {"queue_level", -1}  // Indicate no queue is running
-                };
-                gantt_chart.push_back(idle_slot);
+                sink.segment(-1, current_time, -1);  // Queue level -1: no queue is running
+                sink.endSegment(next_arrival_time);
+                segment_open = false;
                 current_time = next_arrival_time;
                 last_process_id = -1;
                 continue;
@@ -137,31 +140,29 @@ public:
             // Get the next process to execute from the active queue
             int process_index = queues[active_queue].front();
             queues[active_queue].pop_front();
+            in_queue[process_index] = false;
+            countSelection(sink);
+            countQueueOperation(sink);
+            sink.dequeued(process_index);
             current_process_id = sorted_processes[process_index].p_id;
 
             // If this is a different process from the previous one, start a new gantt chart entry
             if (current_process_id != last_process_id) {
                 if (last_process_id != -1) {
-                    gantt_chart.back()["end_time"] = current_time;
+                    sink.endSegment(current_time);
                 }
 
                 // Create a snapshot of all queues for the gantt chart
-                json queues_snapshot = json::array();
-                for (int i = 0; i < num_queues; i++) {
-                    json queue_snapshot = json::array();
-                    for (int process_idx : queues[i]) {
-                        queue_snapshot.push_back(sorted_processes[process_idx].p_id);
+                sink.segment(current_process_id, current_time, active_queue);
+                if (sink.wantsReadyLists()) {
+                    sink.levelSnapshot();
+                    for (int i = 0; i < num_queues; i++) {
+                        for (int process_idx : queues[i]) {
+                            sink.queued(i, sorted_processes[process_idx].p_id);
+                        }
                     }
-                    queues_snapshot.push_back(queue_snapshot);
                 }
-
-                json new_segment = {
-                    {"process_id", current_process_id},
-                    {"start_time", current_time},
-                    {"queues", queues_snapshot},
-                    {"queue_level", active_queue}  // Add the current queue level
-                };
-                gantt_chart.push_back(new_segment);
+                segment_open = true;
                 time_in_current_process = 0;
             }
 
@@ -184,34 +185,17 @@ public:
                 int turnaround_time = completion_time[process_index] - sorted_processes[process_index].arrival_time;
                 int waiting_time = turnaround_time - sorted_processes[process_index].burst_time;
 
-                json stats = {
-                    {"process_id", sorted_processes[process_index].p_id},
-                    {"arrival_time", sorted_processes[process_index].arrival_time},
-                    {"burst_time", sorted_processes[process_index].burst_time},
-                    {"priority", sorted_processes[process_index].priority},
-                    {"completion_time", completion_time[process_index]},
-                    {"turnaround_time", turnaround_time},
-                    {"waiting_time", waiting_time},
-                    {"queue", active_queue}
-                };
-                process_stats.push_back(stats);
+                sink.stat({sorted_processes[process_index].p_id, sorted_processes[process_index].arrival_time,
+                           sorted_processes[process_index].burst_time, sorted_processes[process_index].priority,
+                           completion_time[process_index], turnaround_time, waiting_time, active_queue, 0});
             }
             // If the process still has remaining time, put it back in its queue
             else if (remaining_burst_time[process_index] > 0) {
-                queues[active_queue].push_back(process_index);
+                enqueue(process_index);
             }
 
             // Check for any process that might have arrived during this execution
-            bool new_arrival = false;
-            for (int i = 0; i < n; i++) {
-                if (!is_completed[i] && sorted_processes[i].arrival_time > current_time - execution_time &&
-                    sorted_processes[i].arrival_time <= current_time) {
-                    new_arrival = true;
-                    if (find(queues[queue_assignment[i]].begin(), queues[queue_assignment[i]].end(), i) == queues[queue_assignment[i]].end()) {
-                        queues[queue_assignment[i]].push_back(i);
-                    }
-                }
-            }
+            bool new_arrival = admitArrivals();
 
             // If there's a new arrival and its queue has higher priority, preempt current process
             if (new_arrival) {
@@ -226,20 +210,23 @@ public:
                 
                 if (higher_priority_arrival) {
                     // End the current segment and start a new one
-                    gantt_chart.back()["end_time"] = current_time;
+                    sink.endSegment(current_time);
+                    segment_open = false;
                     last_process_id = -1;  // Force creation of a new segment
                 }
             }
         }
 
         // Complete the last gantt chart entry
-        if (!gantt_chart.empty() && !gantt_chart.back().contains("end_time")) {
-            gantt_chart.back()["end_time"] = current_time;
+        if (segment_open) {
+            sink.endSegment(current_time);
         }
+    }
 
-        result["gantt_chart"] = gantt_chart;
-        result["process_stats"] = process_stats;
-        return result;
+    json schedule(const vector<Process>& processes, int num_queues, int base_quantum) {
+        JsonSink sink;
+        schedule(processes, num_queues, base_quantum, sink);
+        return sink.result();
     }
 };
 
@@ -8,51 +8,91 @@
 #include <climits>
 #include "../Type.hpp"
 #include "../json.hpp"
+#include "EventEngine.hpp"
+#include "OutputSink.hpp"
+#include "ArrivalOrder.hpp"
+#include "ScratchArena.hpp"
 
 using namespace std;
 using json = nlohmann::json;
 
 class MLQAging {
 private:
-    const int AGING_THRESHOLD = 50;
+    // Every queue is FIFO by waiting_since, so only its head can be due for
+    // promotion. Moves each process that has waited aging_threshold ticks up
+    // one level, appending it with push_back(level, index), and reports
+    // whether any moved.
+    template <typename PushBack, typename Sink>
+    static bool promoteAged(pmr::vector<pmr::deque<int>>& queues, pmr::vector<int>& queue_assignment,
+                            pmr::vector<int>& waiting_since, int current_time, int aging_threshold,
+                            PushBack push_back, Sink& sink) {
+        bool promoted = false;
+        for (int q = 1; q < static_cast<int>(queues.size()); q++) {
+            while (!queues[q].empty() && current_time - waiting_since[queues[q].front()] >= aging_threshold) {
+                int i = queues[q].front();
+                queues[q].pop_front();
+                push_back(q - 1, i);
+                countQueueOperation(sink, 2);
+                queue_assignment[i] = q - 1;
+                waiting_since[i] = current_time;
+                promoted = true;
+            }
+        }
+        return promoted;
+    }
+
+    // Earliest time at which some queue head becomes due for promotion, or INT_MAX
+    static int nextPromotionTime(const pmr::vector<pmr::deque<int>>& queues, const pmr::vector<int>& waiting_since,
+                                 int aging_threshold) {
+        long long next_promotion = INT_MAX;
+        for (int q = 1; q < static_cast<int>(queues.size()); q++) {
+            if (!queues[q].empty()) {
+                next_promotion = min(next_promotion,
+                                     static_cast<long long>(waiting_since[queues[q].front()]) + aging_threshold);
+            }
+        }
+        return static_cast<int>(next_promotion);
+    }
 
 public:
-    json schedule(const vector<Process>& processes, int num_queues, int base_quantum) {
+    static ScheduleLayout layout(int num_queues) {
+        return {ReadyLayout::Levels, num_queues, "final_queue", false};
+    }
+
+    template <typename Sink>
+    void schedule(const vector<Process>& processes, int num_queues, int base_quantum, int aging_threshold, Sink& sink) {
+        schedule(ArrivalOrder(processes), num_queues, base_quantum, aging_threshold, sink);
+    }
+
+    template <typename Sink>
+    void schedule(const ArrivalOrder& workload, int num_queues, int base_quantum, int aging_threshold, Sink& sink) {
         if (num_queues <= 0 || base_quantum <= 0) {
-            return json({
-                {"status", "error"},
-                {"message", "Invalid number of queues or base quantum"}
-            });
+            sink.fail("Invalid number of queues or base quantum");
+            return;
         }
-        json result;
-        vector<json> gantt_chart;
-        vector<json> process_stats;
+        sink.begin(layout(num_queues));
 
-        vector<Process> sorted_processes = processes;
-        sort(sorted_processes.begin(), sorted_processes.end(), [](const Process& a, const Process& b) {
-            return a.arrival_time < b.arrival_time;
-        });
+        const vector<Process>& sorted_processes = workload.processes();
 
         int n = sorted_processes.size();
         if (n == 0) {
-            result["gantt_chart"] = gantt_chart;
-            result["process_stats"] = process_stats;
-            return result;
+            return;
         }
 
-        vector<deque<int>> queues(num_queues);
-        vector<int> time_quanta(num_queues);
+        pmr::vector<pmr::deque<int>> queues(num_queues, scratchResource());
+        pmr::vector<int> time_quanta(num_queues, scratchResource());
         
         for (int i = 0; i < num_queues; i++) {
             time_quanta[i] = base_quantum * (1 << i);
         }
 
-        vector<int> remaining_burst_time(n);
-        vector<bool> is_completed(n, false);
-        vector<int> completion_time(n, 0);
-        vector<int> queue_assignment(n);
-        vector<int> waiting_since(n, 0);
-        vector<int> total_wait_time(n, 0);
+        pmr::vector<int> remaining_burst_time(n, scratchResource());
+        pmr::vector<bool> is_completed(n, false, scratchResource());
+        pmr::vector<int> completion_time(n, 0, scratchResource());
+        pmr::vector<int> queue_assignment(n, scratchResource());
+        pmr::vector<int> waiting_since(n, 0, scratchResource());
+        pmr::vector<int> pushes(num_queues, 0, scratchResource());  // per queue: pushes so far, the next order key
+        pmr::vector<int> queue_order(n, 0, scratchResource());      // order key of each process in its queue
         
         for (int i = 0; i < n; i++) {
             remaining_burst_time[i] = sorted_processes[i].burst_time;
@@ -60,42 +100,62 @@ public:
             waiting_since[i] = sorted_processes[i].arrival_time;
         }
 
-        int current_time = 0;
+        EventEngine engine(sorted_processes);
+        int current_time = engine.now();
         int completed = 0;
         int current_process_index = -1;
         bool need_new_gantt_entry = true;
 
-        while (completed < n) {
-            bool queue_changed = false;
-            
-            for (int i = 0; i < n; i++) {
-                if (!is_completed[i] && sorted_processes[i].arrival_time == current_time) {
-                    queues[queue_assignment[i]].push_back(i);
-                    queue_changed = true;
+        // The latest Gantt chart entry, tracked here so the sink is write-only
+        bool has_segment = false;
+        bool segment_open = false;
+        int segment_process_id = -1;
+        int segment_queue_level = -1;
+
+        // Appends a process to a queue, moving it if it waits in another
+        auto pushBack = [&](int queue, int i) {
+            queues[queue].push_back(i);
+            queue_order[i] = pushes[queue]++;
+            sink.enqueued(i, sorted_processes[i].p_id, queue, queue_order[i]);
+        };
+
+        auto endSegment = [&]() {
+            sink.endSegment(current_time);
+            segment_open = false;
+        };
+
+        auto startSegment = [&](int process_id, int queue_level) {
+            sink.segment(process_id, current_time, queue_level);
+            if (sink.wantsReadyLists()) {
+                sink.levelSnapshot();
+                for (int i = 0; i < num_queues; i++) {
+                    for (int idx : queues[i]) {
+                        sink.queued(i, sorted_processes[idx].p_id);
+                    }
                 }
             }
+            has_segment = true;
+            segment_open = true;
+            segment_process_id = process_id;
+            segment_queue_level = queue_level;
+        };
 
-            for (int q = 1; q < num_queues; q++) { 
-                vector<int> to_promote;
-                for (auto it = queues[q].begin(); it != queues[q].end(); ++it) {
-                    int i = *it;
-                    int wait_time = current_time - waiting_since[i];
-                    if (wait_time >= AGING_THRESHOLD) {
-                        to_promote.push_back(i);
-                        queue_changed = true;
-                    }
-                }
+        while (completed < n) {
+            current_time = engine.now();
+            bool queue_changed = false;
+            
+            engine.admitArrivals([&](int i) {
+                pushBack(queue_assignment[i], i);
+                countQueueOperation(sink);
+                queue_changed = true;
+            });
 
-                for (int i : to_promote) {
-                    queues[q].erase(remove(queues[q].begin(), queues[q].end(), i), queues[q].end());
-                    queues[q-1].push_back(i);
-                    queue_assignment[i] = q-1;
-                    waiting_since[i] = current_time;
-                }
+            if (promoteAged(queues, queue_assignment, waiting_since, current_time, aging_threshold, pushBack, sink)) {
+                queue_changed = true;
             }
 
-            if (queue_changed && !gantt_chart.empty()) {
-                gantt_chart.back()["end_time"] = current_time;
+            if (queue_changed && has_segment) {
+                endSegment();
                 need_new_gantt_entry = true;
             }
 
@@ -108,86 +168,49 @@ public:
             }
 
             if (active_queue == -1) {
-                if (need_new_gantt_entry || gantt_chart.empty() || gantt_chart.back()["process_id"] != -1) {
-                    if (!gantt_chart.empty()) {
-                        gantt_chart.back()["end_time"] = current_time;
+                if (need_new_gantt_entry || !has_segment || segment_process_id != -1) {
+                    if (has_segment) {
+                        endSegment();
                     }
 
-                    json queues_snapshot = json::array();
-                    for (int i = 0; i < num_queues; i++) {
-                        json queue_snapshot = json::array();
-                        for (int idx : queues[i]) {
-                            queue_snapshot.push_back(sorted_processes[idx].p_id);
-                        }
-                        queues_snapshot.push_back(queue_snapshot);
-                    }
-
-                    json idle_segment = {
-                        {"process_id", -1},
-                        {"start_time", current_time},
-                        {"queues", queues_snapshot},
-                        {"queue_level", -1}
-                    };
-                    gantt_chart.push_back(idle_segment);
+                    startSegment(-1, -1);
                     need_new_gantt_entry = false;
                 }
 
-                int next_arrival = INT_MAX;
-                for (int i = 0; i < n; i++) {
-                    if (!is_completed[i] && sorted_processes[i].arrival_time > current_time) {
-                        next_arrival = min(next_arrival, sorted_processes[i].arrival_time);
-                    }
-                }
+                int next_arrival = engine.nextArrivalTime();
 
                 if (next_arrival == INT_MAX) {
                     break;
                 }
 
-                current_time = next_arrival;
+                engine.jumpTo(next_arrival);
                 continue;
             }
 
             int process_index = queues[active_queue].front();
             queues[active_queue].pop_front();
+            countSelection(sink);
+            countQueueOperation(sink);
+            sink.dequeued(process_index);
             
-            if (need_new_gantt_entry || current_process_index != process_index || gantt_chart.empty() || 
-                gantt_chart.back()["process_id"] != sorted_processes[process_index].p_id || 
-                gantt_chart.back()["queue_level"] != active_queue) {
+            if (need_new_gantt_entry || current_process_index != process_index || !has_segment || 
+                segment_process_id != sorted_processes[process_index].p_id || 
+                segment_queue_level != active_queue) {
                 
-                if (!gantt_chart.empty()) {
-                    gantt_chart.back()["end_time"] = current_time;
-                }
-
-                json queues_snapshot = json::array();
-                for (int i = 0; i < num_queues; i++) {
-                    json queue_snapshot = json::array();
-                    for (int idx : queues[i]) {
-                        queue_snapshot.push_back(sorted_processes[idx].p_id);
-                    }
-                    queues_snapshot.push_back(queue_snapshot);
+                if (has_segment) {
+                    endSegment();
                 }
 
-                json new_segment = {
-                    {"process_id", sorted_processes[process_index].p_id},
-                    {"start_time", current_time},
-                    {"queues", queues_snapshot},
-                    {"queue_level", active_queue}
-                };
-                gantt_chart.push_back(new_segment);
+                startSegment(sorted_processes[process_index].p_id, active_queue);
                 need_new_gantt_entry = false;
             }
 
             current_process_index = process_index;
 
-            current_time++;
+            engine.advance(1);
+            current_time = engine.now();
             remaining_burst_time[process_index]--;
 
-            for (int i = 0; i < n; i++) {
-                if (!is_completed[i] && i != process_index && sorted_processes[i].arrival_time < current_time) {
-                    total_wait_time[i]++;
-                }
-            }
-
             if (remaining_burst_time[process_index] == 0) {
                 is_completed[process_index] = true;
                 completed++;
@@ -196,59 +219,66 @@ public:
                 int turnaround_time = completion_time[process_index] - sorted_processes[process_index].arrival_time;
                 int waiting_time = turnaround_time - sorted_processes[process_index].burst_time;
 
-                json stats = {
-                    {"process_id", sorted_processes[process_index].p_id},
-                    {"arrival_time", sorted_processes[process_index].arrival_time},
-                    {"burst_time", sorted_processes[process_index].burst_time},
-                    {"priority", sorted_processes[process_index].priority},
-                    {"completion_time", completion_time[process_index]},
-                    {"turnaround_time", turnaround_time},
-                    {"waiting_time", waiting_time},
-                    {"final_queue", queue_assignment[process_index]}
-                };
-                process_stats.push_back(stats);
+                sink.stat({sorted_processes[process_index].p_id, sorted_processes[process_index].arrival_time,
+                           sorted_processes[process_index].burst_time, sorted_processes[process_index].priority,
+                           completion_time[process_index], turnaround_time, waiting_time,
+                           queue_assignment[process_index], 0});
                 need_new_gantt_entry = true;
             } else {
                 int time_slice = time_quanta[active_queue];
                 int process_runtime = sorted_processes[process_index].burst_time - remaining_burst_time[process_index];
                 
                 if (process_runtime % time_slice == 0) {
-                    queues[active_queue].push_back(process_index);
+                    pushBack(active_queue, process_index);
+                    countQueueOperation(sink);
                     waiting_since[process_index] = current_time;
                     need_new_gantt_entry = true;
                 } else {
+                    // Back at the head, under the order key it had there
                     queues[active_queue].push_front(process_index);
+                    countQueueOperation(sink);
+                    sink.enqueued(process_index, sorted_processes[process_index].p_id, active_queue,
+                                  queue_order[process_index]);
                 }
             }
 
-            bool promotion_occurred = false;
-            for (int q = 1; q < num_queues; q++) {
-                for (auto it = queues[q].begin(); it != queues[q].end();) {
-                    int i = *it;
-                    if (current_time - waiting_since[i] >= AGING_THRESHOLD) {
-                        it = queues[q].erase(it);
-                        queue_assignment[i] = q - 1;
-                        queues[q-1].push_back(i);
-                        waiting_since[i] = current_time; 
-                        promotion_occurred = true;
-                    } else {
-                        ++it;
-                    }
-                }
-            }
-            
+            bool promotion_occurred = promoteAged(queues, queue_assignment, waiting_since,
+                                                  current_time, aging_threshold, pushBack, sink);
+
             if (promotion_occurred) {
                 need_new_gantt_entry = true;
             }
+
+            // The process was put back at the head of its queue with nothing else
+            // changed, so it keeps running unobserved until the next arrival,
+            // promotion, quantum boundary or its completion. Jump straight there.
+            if (!need_new_gantt_entry) {
+                int next_promotion = nextPromotionTime(queues, waiting_since, aging_threshold);
+
+                int time_slice = time_quanta[active_queue];
+                int process_runtime = sorted_processes[process_index].burst_time - remaining_burst_time[process_index];
+                int quiet_ticks = min({engine.ticksUntilNextAdmission(),
+                                       next_promotion - current_time - 1,
+                                       time_slice - process_runtime % time_slice - 1,
+                                       remaining_burst_time[process_index] - 1});
+
+                if (quiet_ticks > 0) {
+                    remaining_burst_time[process_index] -= quiet_ticks;
+                    engine.advance(quiet_ticks);
+                    current_time = engine.now();
+                }
+            }
         }
 
-        if (!gantt_chart.empty() && !gantt_chart.back().contains("end_time")) {
-            gantt_chart.back()["end_time"] = current_time;
+        if (segment_open) {
+            endSegment();
         }
+    }
 
-        result["gantt_chart"] = gantt_chart;
-        result["process_stats"] = process_stats;
-        return result;
+    json schedule(const vector<Process>& processes, int num_queues, int base_quantum, int aging_threshold = 50) {
+        JsonSink sink;
+        schedule(processes, num_queues, base_quantum, aging_threshold, sink);
+        return sink.result();
     }
 };
 
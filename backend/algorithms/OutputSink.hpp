@@ -0,0 +1,1043 @@
+#ifndef OUTPUT_SINK_HPP
+#define OUTPUT_SINK_HPP
+#pragma once
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include "../json.hpp"
+#include "ReadyQueueDelta.hpp"
+#include "StreamWriters.hpp"
+#include "QuantileSketch.hpp"
+#include "ScheduleProfile.hpp"
+#include "ScratchArena.hpp"
+
+using namespace std;
+using json = nlohmann::json;
+
+// Output sinks for the schedulers.
+//
+// Every scheduler is a template over its sink and reports its run as a stream
+// of calls: begin() once with the layout of its Gantt rows, then segment() to
+// open a row, ready()/queued() for the processes waiting while it runs,
+// endSegment() to set the end time of the latest row, and stat() once per
+// finished process. Schedulers also report every change to the waiting
+// processes through enqueued()/dequeued(), before the segment() of the first
+// row that shows it, and skip the ready()/queued() walk of their queues when
+// wantsReadyLists() is false. fail() replaces all of that when the parameters are
+// invalid. A scheduler that reports nothing at all (begin() never called)
+// produced no result.
+//
+// JsonSink builds the exact JSON the API has always returned, JsonStreamSink
+// writes the same bytes straight into a response buffer without building a
+// json tree, TraceSink fills flat typed vectors, MetricsSink keeps only a
+// ScheduleSummary of the run, and NullSink drops everything so a scheduler can
+// run for its side effects or timing alone. ProfilingSink wraps a streaming
+// sink to time and count the run.
+
+// How the waiting processes of a Gantt row are reported
+enum class ReadyLayout {
+    Flat,      // "ready_queue": [ids]
+    Levels,    // "queues": [[ids], ...] indexed by queue level, plus "queue_level"
+    LevelMap   // "ready_queues": {"0": [ids], ...} keyed by queue level, plus "queue_level"
+};
+
+struct ScheduleLayout {
+    ReadyLayout ready;
+    int levels;                  // number of queue levels, 0 for Flat
+    const char* stat_level_key;  // key of the queue level in process stats, or nullptr
+    bool stat_aging_wait;        // process stats carry "aging_wait_time"
+};
+
+struct ProcessStat {
+    int process_id;
+    int arrival_time;
+    int burst_time;
+    int priority;
+    int completion_time;
+    int turnaround_time;
+    int waiting_time;
+    int queue_level;      // reported only if the layout has a stat_level_key
+    int aging_wait_time;  // reported only if the layout has stat_aging_wait
+};
+
+class JsonSink {
+private:
+    ScheduleLayout layout = {ReadyLayout::Flat, 0, nullptr, false};
+    bool begun = false;
+    json error;
+    vector<json> gantt_chart;
+    vector<json> process_stats;
+    vector<string> level_keys;
+
+    // The latest row is assembled here and only moved into gantt_chart once
+    // the next one starts, so its ready lists are appended to directly
+    bool has_row = false;
+    bool has_levels = false;
+    json row;
+    json ready_queue;
+    vector<json> level_queues;
+
+    void flushRow() {
+        if (!has_row) {
+            return;
+        }
+
+        if (layout.ready == ReadyLayout::Flat) {
+            row["ready_queue"] = move(ready_queue);
+        } else if (layout.ready == ReadyLayout::Levels) {
+            json queues = json::array();
+            if (has_levels) {
+                for (json& queue : level_queues) {
+                    queues.push_back(move(queue));
+                }
+            }
+            row["queues"] = move(queues);
+        } else {
+            json queues = json::object();
+            if (has_levels) {
+                for (int q = 0; q < layout.levels; q++) {
+                    queues[level_keys[q]] = move(level_queues[q]);
+                }
+            }
+            row["ready_queues"] = move(queues);
+        }
+
+        gantt_chart.push_back(move(row));
+        has_row = false;
+    }
+
+public:
+    void begin(const ScheduleLayout& schedule_layout) {
+        layout = schedule_layout;
+        begun = true;
+        level_keys.clear();
+        for (int q = 0; q < layout.levels; q++) {
+            level_keys.push_back(to_string(q));
+        }
+    }
+
+    void fail(const string& message) {
+        error = {
+            {"status", "error"},
+            {"message", message}
+        };
+    }
+
+    void segment(int process_id, int start_time, int queue_level = -1) {
+        flushRow();
+        row = {
+            {"process_id", process_id},
+            {"start_time", start_time}
+        };
+        if (layout.ready != ReadyLayout::Flat) {
+            row["queue_level"] = queue_level;
+        }
+        ready_queue = json::array();
+        has_levels = false;
+        has_row = true;
+    }
+
+    // Reports every queue level for the current row, even the empty ones
+    void levelSnapshot() {
+        level_queues.assign(layout.levels, json::array());
+        has_levels = true;
+    }
+
+    void ready(int process_id) {
+        ready_queue.push_back(process_id);
+    }
+
+    void queued(int level, int process_id) {
+        level_queues[level].push_back(process_id);
+    }
+
+    bool wantsReadyLists() const {
+        return true;
+    }
+
+    void enqueued(int, int, int, int) {}
+    void dequeued(int) {}
+
+    void endSegment(int end_time) {
+        if (has_row) {
+            row["end_time"] = end_time;
+        }
+    }
+
+    void stat(const ProcessStat& s) {
+        json stats = {
+            {"process_id", s.process_id},
+            {"arrival_time", s.arrival_time},
+            {"burst_time", s.burst_time},
+            {"priority", s.priority},
+            {"completion_time", s.completion_time},
+            {"turnaround_time", s.turnaround_time},
+            {"waiting_time", s.waiting_time}
+        };
+        if (layout.stat_level_key != nullptr) {
+            stats[layout.stat_level_key] = s.queue_level;
+        }
+        if (layout.stat_aging_wait) {
+            stats["aging_wait_time"] = s.aging_wait_time;
+        }
+        process_stats.push_back(move(stats));
+    }
+
+    json result() {
+        if (!error.is_null()) {
+            return error;
+        }
+        if (!begun) {
+            return json();
+        }
+
+        flushRow();
+        json output;
+        output["gantt_chart"] = move(gantt_chart);
+        output["process_stats"] = move(process_stats);
+        return output;
+    }
+};
+
+// Schedule-wide figures gathered from the sink calls while a run goes, with
+// the definitions the frontend's graphs use. Busy time is the length of the
+// rows that run a process. The total time is the latest row end, and the
+// rest of it is idle. A context switch is a row whose process differs from
+// the previous row's, unless the CPU is going idle. Response time is the
+// start of a process's first row minus its arrival.
+class ScheduleSummary {
+private:
+    bool has_row = false;
+    bool row_has_end = false;
+    int row_process_id = 0;
+    int row_start_time = 0;
+    int row_end_time = 0;
+    unordered_map<int, int> first_start;  // process id -> start of its first row
+    vector<QuantileSketch> sketches;      // waiting, turnaround, response; empty unless enabled
+
+    void closeRow() {
+        if (has_row && row_has_end) {
+            total_time = max(total_time, static_cast<long long>(row_end_time));
+            if (row_process_id >= 0) {
+                busy_time += row_end_time - row_start_time;
+            }
+        }
+    }
+
+public:
+    size_t processes = 0;
+    long long total_waiting_time = 0;
+    long long total_turnaround_time = 0;
+    long long total_response_time = 0;
+    long long busy_time = 0;
+    long long total_time = 0;
+    long long context_switches = 0;
+
+    void segment(int process_id, int start_time) {
+        closeRow();
+        if (has_row && process_id != row_process_id && process_id >= 0) {
+            context_switches++;
+        }
+        has_row = true;
+        row_has_end = false;
+        row_process_id = process_id;
+        row_start_time = start_time;
+        if (process_id >= 0) {
+            first_start.emplace(process_id, start_time);
+        }
+    }
+
+    void endSegment(int end_time) {
+        row_end_time = end_time;
+        row_has_end = has_row;
+    }
+
+    void stat(const ProcessStat& s) {
+        processes++;
+        total_waiting_time += s.waiting_time;
+        total_turnaround_time += s.turnaround_time;
+        total_response_time += responseTime(s);
+        if (!sketches.empty()) {
+            sketches[0].add(s.waiting_time);
+            sketches[1].add(s.turnaround_time);
+            sketches[2].add(responseTime(s));
+        }
+    }
+
+    // Also tracks the distributions of waiting, turnaround and response time,
+    // each in a QuantileSketch of the given precision
+    void usePercentiles(int precision_bits) {
+        sketches.assign(3, QuantileSketch(precision_bits));
+    }
+
+    bool hasPercentiles() const {
+        return !sketches.empty();
+    }
+
+    const QuantileSketch& waitingTimes() const {
+        return sketches[0];
+    }
+
+    const QuantileSketch& turnaroundTimes() const {
+        return sketches[1];
+    }
+
+    const QuantileSketch& responseTimes() const {
+        return sketches[2];
+    }
+
+    // Folds in the last row; call once the run is over
+    void finish() {
+        closeRow();
+        has_row = false;
+    }
+
+    int responseTime(const ProcessStat& s) const {
+        auto found = first_start.find(s.process_id);
+        return found != first_start.end() ? found->second - s.arrival_time : 0;
+    }
+
+    long long idleTime() const {
+        return total_time - busy_time;
+    }
+
+    double averageWaitingTime() const {
+        return processes > 0 ? static_cast<double>(total_waiting_time) / processes : 0.0;
+    }
+
+    double averageTurnaroundTime() const {
+        return processes > 0 ? static_cast<double>(total_turnaround_time) / processes : 0.0;
+    }
+
+    double averageResponseTime() const {
+        return processes > 0 ? static_cast<double>(total_response_time) / processes : 0.0;
+    }
+
+    // Percent of the total time spent running processes
+    double cpuUtilization() const {
+        return total_time > 0 ? 100.0 * busy_time / total_time : 0.0;
+    }
+
+    // Completed processes per time unit
+    double throughput() const {
+        return total_time > 0 ? static_cast<double>(processes) / total_time : 0.0;
+    }
+};
+
+// Serializes a run directly into the body of an API response. With the JSON
+// writer the body is byte for byte what JsonSink's result with a "status" key
+// added would dump to: keys in sorted order, no whitespace. The CBOR and
+// MessagePack writers encode the same document, keys in the same order. A row
+// can still get its end time after its ready list is reported, and
+// "end_time" sorts first, so the latest row is held in reusable buffers until
+// the next one starts. Process stats are written after the Gantt chart, as in
+// the JSON, so they are held until finish().
+template <typename Writer>
+class StreamSink {
+private:
+    ScheduleLayout layout = {ReadyLayout::Flat, 0, nullptr, false};
+    bool begun = false;
+    bool failed = false;
+    string error_message;
+    string out;
+    Writer writer{out};
+    size_t rows = 0;
+    size_t rows_at = 0;
+    pmr::vector<ProcessStat> stats{scratchResource()};
+
+    // Level keys are compared as strings, so "10" comes before "2"
+    vector<string> level_keys;
+    vector<int> level_order;
+
+    bool has_row = false;
+    bool has_end = false;
+    bool has_levels = false;
+    int row_process_id = 0;
+    int row_start_time = 0;
+    int row_end_time = 0;
+    int row_queue_level = 0;
+    pmr::vector<pmr::vector<int>> level_ids{scratchResource()};  // level 0 holds the ready queue of the Flat layout
+
+    // Opt-in delta format: rows drop their ready-queue field and the changes
+    // between consecutive rows are listed once under "ready_queue_events"
+    bool delta_format = false;
+    vector<int> snapshot_segments;
+    ReadyQueueChanges changes;
+    pmr::vector<ReadyQueueEvent> events{scratchResource()};
+
+    // Opt-in "summary" block, optionally instead of the chart and stats
+    bool summary_enabled = false;
+    bool summary_only = false;
+    ScheduleSummary summary;
+
+    // Optional last key of a successful document, written by a callback that
+    // is given the number of bytes before it
+    const char* trailer_key = nullptr;
+    function<void(Writer&, size_t)> trailer;
+
+    void writeIds(const pmr::vector<int>& ids) {
+        writer.beginArray(ids.size());
+        for (int id : ids) {
+            writer.integer(id);
+        }
+        writer.endArray();
+    }
+
+    // Writes a ready-queue snapshot in the shape of the layout's row field
+    void writeQueues(const pmr::vector<pmr::vector<int>>& queues, bool present) {
+        size_t count = present ? layout.levels : 0;
+        if (layout.ready == ReadyLayout::Flat) {
+            writeIds(queues[0]);
+        } else if (layout.ready == ReadyLayout::Levels) {
+            writer.beginArray(count);
+            for (size_t q = 0; q < count; q++) {
+                writeIds(queues[q]);
+            }
+            writer.endArray();
+        } else {
+            writer.beginObject(count);
+            for (size_t i = 0; i < count; i++) {
+                int q = level_order[i];
+                writer.key(level_keys[q].c_str());
+                writeIds(queues[q]);
+            }
+            writer.endObject();
+        }
+    }
+
+    void flushRow() {
+        if (!has_row || summary_only) {
+            has_row = false;
+            return;
+        }
+
+        rows++;
+        bool leveled = layout.ready != ReadyLayout::Flat;
+        writer.beginObject(2 + has_end + leveled + !delta_format);
+        if (has_end) {
+            writer.key("end_time");
+            writer.integer(row_end_time);
+        }
+        writer.key("process_id");
+        writer.integer(row_process_id);
+
+        if (leveled) {
+            writer.key("queue_level");
+            writer.integer(row_queue_level);
+        }
+        if (!delta_format) {
+            writer.key(layout.ready == ReadyLayout::Flat ? "ready_queue"
+                       : layout.ready == ReadyLayout::Levels ? "queues" : "ready_queues");
+            writeQueues(level_ids, has_levels);
+        }
+
+        writer.key("start_time");
+        writer.integer(row_start_time);
+        writer.endObject();
+        has_row = false;
+    }
+
+    void writeEvent(const ReadyQueueEvent& event) {
+        static const char* const type_names[] = {"enqueue", "dequeue", "promote", "demote"};
+        bool leveled = layout.ready != ReadyLayout::Flat;
+        bool has_from = leveled && event.from >= 0;
+        bool has_to = leveled && event.to >= 0;
+        bool has_position = event.position >= 0;
+
+        writer.beginObject(4 + has_from + has_to + has_position);
+        if (has_from) {
+            writer.key("from");
+            writer.integer(event.from);
+        }
+        if (has_position) {
+            writer.key("position");
+            writer.integer(event.position);
+        }
+        writer.key("process_id");
+        writer.integer(event.process_id);
+        writer.key("segment");
+        writer.integer(event.segment);
+        writer.key("time");
+        writer.integer(event.time);
+        if (has_to) {
+            writer.key("to");
+            writer.integer(event.to);
+        }
+        writer.key("type");
+        writer.text(type_names[event.type]);
+        writer.endObject();
+    }
+
+    void writeSnapshots() {
+        // Row indices become object keys, which sort as strings
+        vector<string> keys;
+        for (int segment : snapshot_segments) {
+            if (segment >= 0 && segment < static_cast<int>(rows)) {
+                keys.push_back(to_string(segment));
+            }
+        }
+        sort(keys.begin(), keys.end());
+        keys.erase(unique(keys.begin(), keys.end()), keys.end());
+
+        writer.key("snapshots");
+        writer.beginObject(keys.size());
+        for (const string& key : keys) {
+            writer.key(key.c_str());
+            writeQueues(ReadyQueueChanges::replay(events, max(layout.levels, 1), stoi(key)), true);
+        }
+        writer.endObject();
+    }
+
+    void writePercentiles(const QuantileSketch& sketch) {
+        writer.beginObject(5);
+        writer.key("max");
+        writer.integer(sketch.maximum());
+        writer.key("p50");
+        writer.integer(sketch.quantile(0.5));
+        writer.key("p90");
+        writer.integer(sketch.quantile(0.9));
+        writer.key("p99");
+        writer.integer(sketch.quantile(0.99));
+        writer.key("p99_9");
+        writer.integer(sketch.quantile(0.999));
+        writer.endObject();
+    }
+
+    void writeSummary() {
+        summary.finish();
+        writer.key("summary");
+        writer.beginObject(10 + summary.hasPercentiles());
+        writer.key("avg_response_time");
+        writer.number(summary.averageResponseTime());
+        writer.key("avg_turnaround_time");
+        writer.number(summary.averageTurnaroundTime());
+        writer.key("avg_waiting_time");
+        writer.number(summary.averageWaitingTime());
+        writer.key("busy_time");
+        writer.integer(summary.busy_time);
+        writer.key("context_switches");
+        writer.integer(summary.context_switches);
+        writer.key("cpu_utilization");
+        writer.number(summary.cpuUtilization());
+        writer.key("idle_time");
+        writer.integer(summary.idleTime());
+        if (summary.hasPercentiles()) {
+            writer.key("percentiles");
+            writer.beginObject(3);
+            writer.key("response_time");
+            writePercentiles(summary.responseTimes());
+            writer.key("turnaround_time");
+            writePercentiles(summary.turnaroundTimes());
+            writer.key("waiting_time");
+            writePercentiles(summary.waitingTimes());
+            writer.endObject();
+        }
+        writer.key("processes");
+        writer.integer(static_cast<long long>(summary.processes));
+        writer.key("throughput");
+        writer.number(summary.throughput());
+        writer.key("total_time");
+        writer.integer(summary.total_time);
+        writer.endObject();
+    }
+
+    void writeStat(const ProcessStat& s) {
+        // Keys in sorted order, with the optional ones slotted in where they fall
+        const char* level_key = layout.stat_level_key;
+        bool has_level = level_key != nullptr && *level_key != '\0';
+        writer.beginObject(7 + layout.stat_aging_wait + has_level + summary_enabled);
+        if (layout.stat_aging_wait) {
+            writer.key("aging_wait_time");
+            writer.integer(s.aging_wait_time);
+        }
+        writer.key("arrival_time");
+        writer.integer(s.arrival_time);
+        writer.key("burst_time");
+        writer.integer(s.burst_time);
+        writer.key("completion_time");
+        writer.integer(s.completion_time);
+
+        if (has_level && strcmp(level_key, "priority") < 0) {
+            writer.key(layout.stat_level_key);
+            writer.integer(s.queue_level);
+        }
+        writer.key("priority");
+        writer.integer(s.priority);
+        writer.key("process_id");
+        writer.integer(s.process_id);
+        if (has_level && strcmp(level_key, "process_id") > 0) {
+            writer.key(layout.stat_level_key);
+            writer.integer(s.queue_level);
+        }
+        if (summary_enabled) {
+            writer.key("response_time");
+            writer.integer(summary.responseTime(s));
+        }
+        writer.key("turnaround_time");
+        writer.integer(s.turnaround_time);
+        writer.key("waiting_time");
+        writer.integer(s.waiting_time);
+        writer.endObject();
+    }
+
+public:
+    void begin(const ScheduleLayout& schedule_layout) {
+        layout = schedule_layout;
+        begun = true;
+
+        level_keys.clear();
+        level_order.clear();
+        for (int q = 0; q < layout.levels; q++) {
+            level_keys.push_back(to_string(q));
+            level_order.push_back(q);
+        }
+        sort(level_order.begin(), level_order.end(), [&](int a, int b) {
+            return level_keys[a] < level_keys[b];
+        });
+        int queue_count = max(layout.levels, 1);
+        level_ids.assign(queue_count, pmr::vector<int>());
+        changes.reset(queue_count);
+
+        bool has_trailer = trailer_key != nullptr;
+        if (summary_only) {
+            writer.beginObject(2 + has_trailer);  // status and summary
+            return;
+        }
+        // gantt_chart, process_stats and status, plus the optional keys
+        writer.beginObject(3 + (delta_format ? 1 + !snapshot_segments.empty() : 0) + summary_enabled + has_trailer);
+        writer.key("gantt_chart");
+        rows_at = writer.beginOpenArray();
+    }
+
+    void fail(const string& message) {
+        failed = true;
+        error_message = message;
+    }
+
+    void segment(int process_id, int start_time, int queue_level = -1) {
+        flushRow();
+        if (summary_enabled) {
+            summary.segment(process_id, start_time);
+        }
+        if (delta_format && !summary_only) {
+            changes.flush(static_cast<int>(rows), start_time, events);
+        }
+        row_process_id = process_id;
+        row_start_time = start_time;
+        row_queue_level = queue_level;
+        has_end = false;
+        has_levels = layout.ready == ReadyLayout::Flat;
+        if (has_levels) {
+            level_ids[0].clear();
+        }
+        has_row = true;
+    }
+
+    void levelSnapshot() {
+        for (pmr::vector<int>& ids : level_ids) {
+            ids.clear();
+        }
+        has_levels = true;
+    }
+
+    void ready(int process_id) {
+        level_ids[0].push_back(process_id);
+    }
+
+    void queued(int level, int process_id) {
+        level_ids[level].push_back(process_id);
+    }
+
+    // Rows in the delta format, and the rows left out by a summary-only
+    // document, list no waiting processes
+    bool wantsReadyLists() const {
+        return !delta_format && !summary_only;
+    }
+
+    void enqueued(int index, int process_id, int level, int order) {
+        if (delta_format && !summary_only) {
+            changes.enqueue(index, process_id, level, order);
+        }
+    }
+
+    void dequeued(int index) {
+        if (delta_format && !summary_only) {
+            changes.dequeue(index);
+        }
+    }
+
+    void endSegment(int end_time) {
+        if (has_row) {
+            row_end_time = end_time;
+            has_end = true;
+        }
+        if (summary_enabled) {
+            summary.endSegment(end_time);
+        }
+    }
+
+    void stat(const ProcessStat& s) {
+        if (summary_enabled) {
+            summary.stat(s);
+        }
+        if (!summary_only) {
+            stats.push_back(s);
+        }
+    }
+
+    // Adds a "summary" block with the run's ScheduleSummary and a
+    // "response_time" to every process stat. With only set, the summary
+    // replaces the Gantt chart and the process stats.
+    void useSummary(bool only = false) {
+        summary_enabled = true;
+        summary_only = only;
+    }
+
+    // Adds p50, p90, p99, p99.9 and max of the waiting, turnaround and
+    // response times to the summary, turning the summary on if needed
+    void usePercentiles(int precision_bits) {
+        summary_enabled = true;
+        summary.usePercentiles(precision_bits);
+    }
+
+    // Switches to the delta format before the run starts. The ready queues of
+    // the listed rows are rebuilt from the events and returned under
+    // "snapshots", keyed by row index.
+    void useDeltaFormat(const vector<int>& segments = {}) {
+        delta_format = true;
+        snapshot_segments = segments;
+    }
+
+    // Adds a top-level key after all others, whose value write() produces
+    // once the rest of the document is written
+    void useTrailer(const char* key, function<void(Writer&, size_t)> write) {
+        trailer_key = key;
+        trailer = move(write);
+    }
+
+    // Completes the document with a top-level "status" and hands over the buffer.
+    // A failed run reports only its message; a run that reported nothing at all
+    // reports only the status.
+    string finish(const string& status) {
+        if (failed) {
+            out.clear();
+            writer.reset();
+            writer.beginObject(2);
+            writer.key("message");
+            writer.text(error_message);
+        } else if (begun && summary_only) {
+            // Only the summary follows
+        } else if (begun) {
+            flushRow();
+            writer.endOpenArray(rows_at, rows);
+            writer.key("process_stats");
+            writer.beginArray(stats.size());
+            for (const ProcessStat& s : stats) {
+                writeStat(s);
+            }
+            writer.endArray();
+
+            if (delta_format) {
+                writer.key("ready_queue_events");
+                writer.beginArray(events.size());
+                for (const ReadyQueueEvent& event : events) {
+                    writeEvent(event);
+                }
+                writer.endArray();
+
+                if (!snapshot_segments.empty()) {
+                    writeSnapshots();
+                }
+            }
+        } else {
+            writer.beginObject(1);
+        }
+        writer.key("status");
+        writer.text(status);
+        if (begun && !failed && summary_enabled) {
+            writeSummary();
+        }
+        if (begun && !failed && trailer_key != nullptr) {
+            writer.key(trailer_key);
+            trailer(writer, out.size());
+        }
+        writer.endObject();
+        return move(out);
+    }
+};
+
+using JsonStreamSink = StreamSink<JsonTextWriter>;
+using CborStreamSink = StreamSink<CborWriter>;
+using MsgPackStreamSink = StreamSink<MsgPackWriter>;
+
+// Struct-of-vectors record of a run. Row s waits on
+// ready_ids[ready_begin[s], ready_begin[s + 1]), with the queue level of each
+// entry in ready_level for the leveled layouts.
+struct ScheduleTrace {
+    ScheduleLayout layout = {ReadyLayout::Flat, 0, nullptr, false};
+    bool begun = false;
+    string error;
+
+    vector<int> process_id;
+    vector<int> start_time;
+    vector<int> end_time;
+    vector<char> has_end_time;
+    vector<int> queue_level;
+    vector<char> has_levels;
+    vector<size_t> ready_begin = {0};
+    vector<int> ready_ids;
+    vector<int> ready_level;
+
+    vector<ProcessStat> stats;
+
+    size_t segments() const {
+        return process_id.size();
+    }
+};
+
+class TraceSink {
+private:
+    ScheduleTrace& trace;
+
+public:
+    explicit TraceSink(ScheduleTrace& output) : trace(output) {}
+
+    void begin(const ScheduleLayout& schedule_layout) {
+        trace.layout = schedule_layout;
+        trace.begun = true;
+    }
+
+    void fail(const string& message) {
+        trace.error = message;
+    }
+
+    void segment(int process_id, int start_time, int queue_level = -1) {
+        trace.process_id.push_back(process_id);
+        trace.start_time.push_back(start_time);
+        trace.end_time.push_back(0);
+        trace.has_end_time.push_back(0);
+        trace.queue_level.push_back(queue_level);
+        trace.has_levels.push_back(0);
+        trace.ready_begin.push_back(trace.ready_ids.size());
+    }
+
+    void levelSnapshot() {
+        trace.has_levels.back() = 1;
+    }
+
+    void ready(int process_id) {
+        trace.ready_ids.push_back(process_id);
+        trace.ready_level.push_back(-1);
+        trace.ready_begin.back()++;
+    }
+
+    void queued(int level, int process_id) {
+        trace.ready_ids.push_back(process_id);
+        trace.ready_level.push_back(level);
+        trace.ready_begin.back()++;
+    }
+
+    bool wantsReadyLists() const {
+        return true;
+    }
+
+    void enqueued(int, int, int, int) {}
+    void dequeued(int) {}
+
+    void endSegment(int end_time) {
+        if (!trace.end_time.empty()) {
+            trace.end_time.back() = end_time;
+            trace.has_end_time.back() = 1;
+        }
+    }
+
+    void stat(const ProcessStat& s) {
+        trace.stats.push_back(s);
+    }
+};
+
+// Keeps only the ScheduleSummary of a run, without its Gantt chart
+class MetricsSink {
+private:
+    bool failed = false;
+    string error_message;
+
+public:
+    ScheduleSummary summary;
+
+    void begin(const ScheduleLayout&) {}
+
+    void fail(const string& message) {
+        failed = true;
+        error_message = message;
+    }
+
+    void segment(int process_id, int start_time, int = -1) {
+        summary.segment(process_id, start_time);
+    }
+
+    void levelSnapshot() {}
+    void ready(int) {}
+    void queued(int, int) {}
+
+    bool wantsReadyLists() const {
+        return false;
+    }
+
+    void enqueued(int, int, int, int) {}
+    void dequeued(int) {}
+
+    void endSegment(int end_time) {
+        summary.endSegment(end_time);
+    }
+
+    void stat(const ProcessStat& s) {
+        summary.stat(s);
+    }
+
+    bool ok() const {
+        return !failed;
+    }
+
+    const string& error() const {
+        return error_message;
+    }
+};
+
+class NullSink {
+public:
+    void begin(const ScheduleLayout&) {}
+    void fail(const string&) {}
+    void segment(int, int, int = -1) {}
+    void levelSnapshot() {}
+    void ready(int) {}
+    void queued(int, int) {}
+    bool wantsReadyLists() const { return false; }
+    void enqueued(int, int, int, int) {}
+    void dequeued(int) {}
+    void endSegment(int) {}
+    void stat(const ProcessStat&) {}
+};
+
+// Wraps a streaming sink and adds a "profile" block as the last key of its
+// document: wall time of each phase of the request, the run's
+// ScheduleProfile, the bytes written before the block and the allocations
+// the request thread made since the sink was created. Phases are measured as:
+//   decode     from receipt of the request to startRun()
+//   sort       from startRun() to begin(), which schedulers call once the
+//              workload is in arrival order
+//   schedule   from begin() to finish(); the rows are encoded as they are
+//              produced, so this includes writing them
+//   serialize  from finish() to the profile block
+template <typename Sink>
+class ProfilingSink : public Sink {
+private:
+    using Clock = chrono::steady_clock;
+    Clock::time_point received;
+    Clock::time_point run_started;
+    Clock::time_point begun_at;
+    Clock::time_point finishing;
+    bool has_begun = false;
+    bool row_has_snapshot = false;
+    AllocationCount allocations;
+
+    static double micros(Clock::duration duration) {
+        return chrono::duration<double, micro>(duration).count();
+    }
+
+    template <typename Writer>
+    void writeProfile(Writer& writer, size_t bytes_written) {
+        Clock::time_point now = Clock::now();
+        Clock::time_point scheduled = has_begun ? begun_at : run_started;
+        writer.beginObject(11);
+        writer.key("allocations");
+        writer.integer(static_cast<long long>(allocations.count()));
+        writer.key("bytes_serialized");
+        writer.integer(static_cast<long long>(bytes_written));
+        writer.key("decode_us");
+        writer.number(micros(run_started - received));
+        writer.key("queue_operations");
+        writer.integer(static_cast<long long>(profile.queue_operations));
+        writer.key("schedule_us");
+        writer.number(micros(finishing - scheduled));
+        writer.key("segments");
+        writer.integer(static_cast<long long>(profile.segments));
+        writer.key("selections");
+        writer.integer(static_cast<long long>(profile.selections));
+        writer.key("serialize_us");
+        writer.number(micros(now - finishing));
+        writer.key("snapshot_entries");
+        writer.integer(static_cast<long long>(profile.snapshot_entries));
+        writer.key("snapshots");
+        writer.integer(static_cast<long long>(profile.snapshots));
+        writer.key("sort_us");
+        writer.number(micros(scheduled - run_started));
+        writer.endObject();
+    }
+
+    void noteSnapshot() {
+        if (!row_has_snapshot) {
+            row_has_snapshot = true;
+            profile.snapshots++;
+        }
+    }
+
+public:
+    ScheduleProfile profile;
+
+    explicit ProfilingSink(Clock::time_point request_received)
+        : received(request_received), run_started(request_received) {
+        Sink::useTrailer("profile", [this](auto& writer, size_t bytes_written) {
+            writeProfile(writer, bytes_written);
+        });
+    }
+
+    // The trailer refers to this sink, so it must stay where it is
+    ProfilingSink(const ProfilingSink&) = delete;
+    ProfilingSink& operator=(const ProfilingSink&) = delete;
+
+    void startRun() {
+        run_started = Clock::now();
+    }
+
+    void begin(const ScheduleLayout& schedule_layout) {
+        begun_at = Clock::now();
+        has_begun = true;
+        Sink::begin(schedule_layout);
+    }
+
+    void segment(int process_id, int start_time, int queue_level = -1) {
+        profile.segments++;
+        row_has_snapshot = false;
+        Sink::segment(process_id, start_time, queue_level);
+    }
+
+    void levelSnapshot() {
+        noteSnapshot();
+        Sink::levelSnapshot();
+    }
+
+    void ready(int process_id) {
+        noteSnapshot();
+        profile.snapshot_entries++;
+        Sink::ready(process_id);
+    }
+
+    void queued(int level, int process_id) {
+        noteSnapshot();
+        profile.snapshot_entries++;
+        Sink::queued(level, process_id);
+    }
+
+    string finish(const string& status) {
+        finishing = Clock::now();
+        return Sink::finish(status);
+    }
+};
+
+#endif
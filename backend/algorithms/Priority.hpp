@@ -7,140 +7,169 @@
 #include <climits>
 #include "../Type.hpp"
 #include "../json.hpp"
+#include "EventEngine.hpp"
+#include "OutputSink.hpp"
+#include "ArrivalOrder.hpp"
+#include "ScratchArena.hpp"
+#include "PriorityReadyQueue.hpp"
 
 using namespace std;
 using json = nlohmann::json;
 
 class Priority {
 public:
-    json schedule(const vector<Process>& processes) {
-        vector<json> gantt_chart;
-        vector<json> process_stats;
+    static ScheduleLayout layout() {
+        return {ReadyLayout::Flat, 0, nullptr, false};
+    }
+
+    template <typename Sink>
+    void schedule(const vector<Process>& processes, Sink& sink) {
+        schedule(ArrivalOrder(processes), sink);
+    }
+
+    template <typename Sink>
+    void schedule(const ArrivalOrder& workload, Sink& sink) {
+        sink.begin(layout());
 
-        vector<Process> sorted_processes = processes;
-        sort(sorted_processes.begin(), sorted_processes.end(), [](const Process& a, const Process& b) {
-            return a.arrival_time < b.arrival_time;
-        });
+        const vector<Process>& sorted_processes = workload.processes();
 
-        int current_time = 0;
         int completed = 0;
         int n = sorted_processes.size();
-        vector<int> remaining_burst_time(n);
-        vector<bool> is_completed(n, false);
+        pmr::vector<int> remaining_burst_time(n, scratchResource());
+        int min_priority = n > 0 ? sorted_processes[0].priority : 0;
+        int max_priority = min_priority;
 
         for (int i = 0; i < n; i++) {
             remaining_burst_time[i] = sorted_processes[i].burst_time;
+            min_priority = min(min_priority, sorted_processes[i].priority);
+            max_priority = max(max_priority, sorted_processes[i].priority);
         }
 
         int last_process_id = -1;
-        int idle_start_time = -1;
+        EventEngine engine(sorted_processes);
+
+        // Ready processes other than the running one
+        PriorityReadyQueue ready_queue(min_priority, max_priority);
+        auto entryFor = [&](int i) {
+            return PriorityReadyQueue::Entry{sorted_processes[i].priority, sorted_processes[i].arrival_time,
+                                             remaining_burst_time[i], i};
+        };
+        int running_index = -1;
+
+        // The ready queue of a row lists the arrived, unfinished processes in
+        // arrival order, leaving out the one the row runs
+        int reported = 0;        // processes [0, reported) have been reported as enqueued
+        int left_out = -1;       // the process the latest row runs
+        auto reportReady = [&](int running) {
+            for (; reported < engine.arrivedCount(); reported++) {
+                sink.enqueued(reported, sorted_processes[reported].p_id, 0, reported);
+            }
+            if (left_out != running) {
+                if (left_out != -1 && remaining_burst_time[left_out] > 0) {
+                    sink.enqueued(left_out, sorted_processes[left_out].p_id, 0, left_out);
+                }
+                sink.dequeued(running);
+                left_out = running;
+            }
+        };
 
         while (completed < n) {
-            int highest_priority_index = -1;
-            int highest_priority = INT_MAX;
-
-            for (int i = 0; i < n; i++) {
-                if (sorted_processes[i].arrival_time <= current_time && !is_completed[i]) {
-                    if (sorted_processes[i].priority < highest_priority ||
-                       (sorted_processes[i].priority == highest_priority && 
-                        sorted_processes[i].arrival_time < sorted_processes[highest_priority_index].arrival_time) ||
-                       (sorted_processes[i].priority == highest_priority && 
-                        sorted_processes[i].arrival_time == sorted_processes[highest_priority_index].arrival_time &&
-                        remaining_burst_time[i] < remaining_burst_time[highest_priority_index])) {
-                        highest_priority = sorted_processes[i].priority;
-                        highest_priority_index = i;
-                    }
+            int current_time = engine.now();
+            engine.admitArrivals([&](int i) {
+                ready_queue.push(entryFor(i));
+                countQueueOperation(sink);
+            });
+
+            // Lower priority value wins, then earlier arrival, then less remaining
+            // time; the running process is preempted only by a strictly better key
+            int highest_priority_index = running_index;
+            if (!ready_queue.empty() &&
+                (highest_priority_index == -1 || ready_queue.top() < entryFor(highest_priority_index))) {
+                if (highest_priority_index != -1) {
+                    ready_queue.push(entryFor(highest_priority_index));
+                    countQueueOperation(sink);
                 }
+                highest_priority_index = ready_queue.top().index;
+                ready_queue.pop();
+                countSelection(sink);
+                countQueueOperation(sink);
             }
+            running_index = highest_priority_index;
 
             if (highest_priority_index == -1) {
                 if (last_process_id != -1 && last_process_id != -2) {
-                    gantt_chart.back()["end_time"] = current_time;
-                    idle_start_time = current_time;
-                    gantt_chart.push_back({
-                        {"process_id", -1},
-                        {"start_time", current_time},
-                        {"ready_queue", vector<int>()}
-                    });
+                    sink.endSegment(current_time);
+                    sink.segment(-1, current_time);
                     last_process_id = -2;
                 }
-                current_time++;
+                engine.jumpTo(engine.nextArrivalTime());
                 continue;
             } else {
                 if (last_process_id == -2) {
-                    gantt_chart.back()["end_time"] = current_time;
+                    sink.endSegment(current_time);
                     last_process_id = -1;
                 }
             }
 
             if (last_process_id != sorted_processes[highest_priority_index].p_id) {
                 if (last_process_id >= 0) {
-                    gantt_chart.back()["end_time"] = current_time;
+                    sink.endSegment(current_time);
                 }
-                gantt_chart.push_back({
-                    {"process_id", sorted_processes[highest_priority_index].p_id},
-                    {"start_time", current_time},
-                    {"ready_queue", vector<int>()}
-                });
-                for (int i = 0; i < n; i++) {
-                    if (!is_completed[i] && sorted_processes[i].arrival_time <= current_time && 
-                        i != highest_priority_index) {
-                        gantt_chart.back()["ready_queue"].push_back(sorted_processes[i].p_id);
-                    }
+                reportReady(highest_priority_index);
+                sink.segment(sorted_processes[highest_priority_index].p_id, current_time);
+                if (sink.wantsReadyLists()) {
+                    engine.forEachActive([&](int i) {
+                        if (i != highest_priority_index) {
+                            sink.ready(sorted_processes[i].p_id);
+                        }
+                    });
                 }
             }
 
             last_process_id = sorted_processes[highest_priority_index].p_id;
 
-            remaining_burst_time[highest_priority_index]--;
-            current_time++;
-
-            for (int i = 0; i < n; i++) {
-                if (sorted_processes[i].arrival_time == current_time && !is_completed[i]) {
-                    gantt_chart.back()["end_time"] = current_time;
-                    gantt_chart.push_back({
-                        {"process_id", sorted_processes[highest_priority_index].p_id},
-                        {"start_time", current_time},
-                        {"ready_queue", vector<int>()}
-                    });
-                    for (int j = 0; j < n; j++) {
-                        if (!is_completed[j] && sorted_processes[j].arrival_time <= current_time && 
-                            j != highest_priority_index) {
-                            gantt_chart.back()["ready_queue"].push_back(sorted_processes[j].p_id);
+            // Running only lowers the remaining burst, the last tie-breaker, so the
+            // choice can only change on the next arrival or on completion
+            int run_time = min(remaining_burst_time[highest_priority_index], engine.ticksUntilNextArrival());
+            remaining_burst_time[highest_priority_index] -= run_time;
+            engine.advance(run_time);
+            current_time = engine.now();
+
+            if (engine.arrivalAtNow()) {
+                sink.endSegment(current_time);
+                reportReady(highest_priority_index);
+                sink.segment(sorted_processes[highest_priority_index].p_id, current_time);
+                if (sink.wantsReadyLists()) {
+                    engine.forEachActive([&](int j) {
+                        if (j != highest_priority_index) {
+                            sink.ready(sorted_processes[j].p_id);
                         }
-                    }
-                    break;
+                    });
                 }
             }
 
             if (remaining_burst_time[highest_priority_index] == 0) {
-                is_completed[highest_priority_index] = true;
+                engine.finish(highest_priority_index);
+                running_index = -1;
                 completed++;
 
                 int completion_time = current_time;
                 int turnaround_time = completion_time - sorted_processes[highest_priority_index].arrival_time;
                 int waiting_time = turnaround_time - sorted_processes[highest_priority_index].burst_time;
 
-                process_stats.push_back({
-                    {"process_id", sorted_processes[highest_priority_index].p_id},
-                    {"arrival_time", sorted_processes[highest_priority_index].arrival_time},
-                    {"burst_time", sorted_processes[highest_priority_index].burst_time},
-                    {"priority", sorted_processes[highest_priority_index].priority},
-                    {"completion_time", completion_time},
-                    {"turnaround_time", turnaround_time},
-                    {"waiting_time", waiting_time}
-                });
+                sink.stat({sorted_processes[highest_priority_index].p_id, sorted_processes[highest_priority_index].arrival_time,
+                           sorted_processes[highest_priority_index].burst_time, sorted_processes[highest_priority_index].priority,
+                           completion_time, turnaround_time, waiting_time, -1, 0});
             }
         }
 
-        if (!gantt_chart.empty()) {
-            gantt_chart.back()["end_time"] = current_time;
-        }
+        sink.endSegment(engine.now());
+    }
 
-        json result;
-        result["gantt_chart"] = gantt_chart;
-        result["process_stats"] = process_stats;
-        return result;
+    json schedule(const vector<Process>& processes) {
+        JsonSink sink;
+        schedule(processes, sink);
+        return sink.result();
     }
 };
 
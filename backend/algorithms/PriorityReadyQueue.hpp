@@ -0,0 +1,106 @@
+#ifndef PRIORITY_READY_QUEUE_HPP
+#define PRIORITY_READY_QUEUE_HPP
+#pragma once
+#include <vector>
+#include <queue>
+#include <tuple>
+#include <cstdint>
+#include <functional>
+#include "ScratchArena.hpp"
+
+using namespace std;
+
+// Ready set for the Priority scheduler, ordered by (priority, arrival time,
+// remaining burst, arrival order) - the same tie-breaking the scheduler has
+// always used. When the priorities span at most MAX_LEVELS values, each level
+// gets its own heap and a two-level bitmap of non-empty levels, so the best
+// level is found with two find-first-set operations. Wider ranges fall back to
+// a single heap over the full key.
+class PriorityReadyQueue {
+public:
+    struct Entry {
+        int priority;
+        int arrival_time;
+        int remaining_time;
+        int index;
+
+        bool operator<(const Entry& other) const {
+            return tie(priority, arrival_time, remaining_time, index) <
+                   tie(other.priority, other.arrival_time, other.remaining_time, other.index);
+        }
+
+        bool operator>(const Entry& other) const {
+            return other < *this;
+        }
+    };
+
+    static constexpr int MAX_LEVELS = 64 * 64;
+
+private:
+    using MinHeap = priority_queue<Entry, pmr::vector<Entry>, greater<Entry>>;
+
+    int base_priority;
+    bool bucketed;
+    int count;
+    pmr::vector<MinHeap> levels;
+    pmr::vector<uint64_t> level_bits;  // bit (l % 64) of word (l / 64) is set if level l is non-empty
+    uint64_t word_bits;           // bit w is set if level_bits[w] is non-zero
+    MinHeap fallback;
+
+    int bestLevel() const {
+        int word = __builtin_ctzll(word_bits);
+        return word * 64 + __builtin_ctzll(level_bits[word]);
+    }
+
+public:
+    PriorityReadyQueue(int min_priority, int max_priority)
+        : base_priority(min_priority),
+          bucketed(static_cast<long long>(max_priority) - min_priority < MAX_LEVELS),
+          count(0), levels(scratchResource()), level_bits(scratchResource()), word_bits(0),
+          fallback(scratchResource()) {
+        if (bucketed) {
+            levels.resize(max_priority - min_priority + 1);
+            level_bits.assign((levels.size() + 63) / 64, 0);
+        }
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    void push(const Entry& entry) {
+        count++;
+        if (!bucketed) {
+            fallback.push(entry);
+            return;
+        }
+
+        int level = entry.priority - base_priority;
+        levels[level].push(entry);
+        level_bits[level / 64] |= 1ULL << (level % 64);
+        word_bits |= 1ULL << (level / 64);
+    }
+
+    const Entry& top() const {
+        return bucketed ? levels[bestLevel()].top() : fallback.top();
+    }
+
+    void pop() {
+        count--;
+        if (!bucketed) {
+            fallback.pop();
+            return;
+        }
+
+        int level = bestLevel();
+        levels[level].pop();
+        if (levels[level].empty()) {
+            level_bits[level / 64] &= ~(1ULL << (level % 64));
+            if (level_bits[level / 64] == 0) {
+                word_bits &= ~(1ULL << (level / 64));
+            }
+        }
+    }
+};
+
+#endif
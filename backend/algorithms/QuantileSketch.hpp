@@ -0,0 +1,97 @@
+#ifndef QUANTILE_SKETCH_HPP
+#define QUANTILE_SKETCH_HPP
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <climits>
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+// Fixed-memory streaming quantile sketch over non-negative ints, laid out
+// like an HDR histogram. Values below 2^(bits + 1) get a counter each; above
+// that, every power-of-two range is split into 2^bits equal buckets. A
+// reported quantile is the highest value its bucket holds, capped at the
+// largest value recorded. That is never below the true value and at most a
+// fraction 2^-bits above it. Memory depends only on bits, never on the number
+// of values: about (32 - bits) * 2^bits counters.
+class QuantileSketch {
+private:
+    int bits;
+    int64_t sub_buckets;  // 2^bits
+    vector<uint64_t> counts;
+    uint64_t total = 0;
+    int64_t largest = 0;
+
+    int shiftFor(int64_t value) const {
+        int length = 0;
+        while ((value >> length) != 0) {
+            length++;
+        }
+        return max(0, length - (bits + 1));
+    }
+
+    size_t bucketFor(int64_t value) const {
+        int shift = shiftFor(value);
+        return static_cast<size_t>(shift * sub_buckets + (value >> shift));
+    }
+
+    // Largest value that falls into the bucket
+    int64_t highestIn(size_t bucket) const {
+        int64_t index = static_cast<int64_t>(bucket);
+        int shift = index < 2 * sub_buckets ? 0 : static_cast<int>(index / sub_buckets) - 1;
+        int64_t lowest = (index - shift * sub_buckets) << shift;
+        return lowest + (int64_t(1) << shift) - 1;
+    }
+
+public:
+    explicit QuantileSketch(int precision_bits = 7)
+        : bits(min(max(precision_bits, 1), 12)), sub_buckets(int64_t(1) << bits),
+          counts(bucketFor(INT_MAX) + 1, 0) {}
+
+    // Precision bits that keep the relative error within `accuracy`
+    static int bitsFor(double accuracy) {
+        if (!(accuracy > 0.0)) {
+            return 12;
+        }
+        return min(max(static_cast<int>(ceil(log2(1.0 / accuracy))), 1), 12);
+    }
+
+    // Negative values are recorded as 0
+    void add(int value) {
+        int64_t v = max(value, 0);
+        counts[bucketFor(v)]++;
+        total++;
+        largest = max(largest, v);
+    }
+
+    uint64_t count() const {
+        return total;
+    }
+
+    int64_t maximum() const {
+        return largest;
+    }
+
+    // Value at quantile q in [0, 1]: the smallest recorded value with at
+    // least ceil(q * count) values at or below it, within the sketch's error.
+    int64_t quantile(double q) const {
+        if (total == 0) {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(ceil(q * static_cast<double>(total)));
+        rank = min(max(rank, uint64_t(1)), total);
+
+        uint64_t seen = 0;
+        for (size_t bucket = 0; bucket < counts.size(); bucket++) {
+            seen += counts[bucket];
+            if (seen >= rank) {
+                return min(highestIn(bucket), largest);
+            }
+        }
+        return largest;
+    }
+};
+
+#endif
@@ -0,0 +1,209 @@
+#ifndef READY_QUEUE_DELTA_HPP
+#define READY_QUEUE_DELTA_HPP
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include "ScratchArena.hpp"
+
+using namespace std;
+
+// A change to the ready queues between two consecutive Gantt rows.
+// Levels are 0 for the single-queue schedulers.
+struct ReadyQueueEvent {
+    enum Type { Enqueue, Dequeue, Promote, Demote };
+
+    Type type;
+    int segment;     // Gantt row the change leads into
+    int time;        // start time of that row
+    int process_id;
+    int from;        // level left by Dequeue, Promote and Demote, else -1
+    int to;          // level entered by Enqueue, Promote and Demote, else -1
+    int position;    // index in level `to` once the row's changes are applied, else -1
+};
+
+// Turns the changes a scheduler makes to its ready structures into the events
+// of each Gantt row, at a cost that grows with the number of changes rather
+// than with the length of the queues.
+//
+// A waiting process sits in one level at an order key the scheduler picks:
+// its arrival index, or a push count for a FIFO level. Each level lists its
+// processes by ascending key, and a Fenwick tree per level counts them by key
+// to give the positions. Changes are netted per row, so a process that enters
+// and leaves the queues between two rows is not reported, and one that only
+// changed its key within a level is a Dequeue and an Enqueue.
+//
+// The events of one row are applied in two passes: first every Dequeue,
+// Promote and Demote removes its process from level `from`, then every
+// Enqueue, Promote and Demote inserts its process at `position` in level `to`,
+// in the order listed (ascending position within each level). Removals are
+// listed first, by level and then by place in the previous row.
+class ReadyQueueChanges {
+private:
+    struct Place {
+        int level;  // -1 while not waiting
+        int order;
+    };
+
+    pmr::vector<Place> place;        // per process index
+    pmr::vector<Place> row_place;    // per touched process: its place at the last row
+    pmr::vector<int> process_ids;
+    pmr::vector<char> is_touched;
+    pmr::vector<int> touched;        // processes changed since the last row
+    pmr::vector<pmr::vector<int>> trees;
+
+    // Working space of flush(), kept between rows
+    pmr::vector<pair<Place, int>> removals;  // (place left, process id)
+    pmr::vector<ReadyQueueEvent> insertions;
+
+    void touch(int index) {
+        if (index >= static_cast<int>(place.size())) {
+            place.resize(index + 1, {-1, 0});
+            row_place.resize(index + 1);
+            process_ids.resize(index + 1);
+            is_touched.resize(index + 1, 0);
+        }
+        if (!is_touched[index]) {
+            is_touched[index] = 1;
+            row_place[index] = place[index];
+            touched.push_back(index);
+        }
+    }
+
+    // Adds delta to the count of a key. A tree that is too small is doubled:
+    // the new half only covers larger keys, so all its nodes start at zero
+    // except the last, which spans the whole range.
+    void count(int level, int order, int delta) {
+        pmr::vector<int>& tree = trees[level];
+        while (order >= static_cast<int>(tree.size())) {
+            int total = tree.empty() ? 0 : tree.back();
+            tree.resize(max<size_t>(tree.size() * 2, 64), 0);
+            tree.back() = total;
+        }
+        for (size_t node = order + 1; node <= tree.size(); node += node & (~node + 1)) {
+            tree[node - 1] += delta;
+        }
+    }
+
+    // Waiting processes of a level with a smaller key
+    int rank(int level, int order) const {
+        const pmr::vector<int>& tree = trees[level];
+        int total = 0;
+        for (size_t node = min(static_cast<size_t>(order), tree.size()); node > 0; node -= node & (~node + 1)) {
+            total += tree[node - 1];
+        }
+        return total;
+    }
+
+public:
+    ReadyQueueChanges()
+        : place(scratchResource()), row_place(scratchResource()), process_ids(scratchResource()),
+          is_touched(scratchResource()), touched(scratchResource()), trees(scratchResource()),
+          removals(scratchResource()), insertions(scratchResource()) {}
+
+    void reset(int levels) {
+        place.clear();
+        row_place.clear();
+        process_ids.clear();
+        is_touched.clear();
+        touched.clear();
+        trees.assign(levels, pmr::vector<int>());
+    }
+
+    // The process with this scheduler index now waits in level at key order,
+    // wherever it waited before. Keys are non-negative and unique per level.
+    void enqueue(int index, int process_id, int level, int order) {
+        touch(index);
+        Place& current = place[index];
+        if (current.level >= 0) {
+            count(current.level, current.order, -1);
+        }
+        current = {level, order};
+        count(level, order, 1);
+        process_ids[index] = process_id;
+    }
+
+    // The process no longer waits; nothing happens if it did not
+    void dequeue(int index) {
+        if (index >= static_cast<int>(place.size()) || place[index].level < 0) {
+            return;
+        }
+        touch(index);
+        count(place[index].level, place[index].order, -1);
+        place[index].level = -1;
+    }
+
+    // Appends the events that lead from the previous row's queues to the
+    // current ones, as the queues of row `segment`, which starts at `time`.
+    void flush(int segment, int time, pmr::vector<ReadyQueueEvent>& events) {
+        removals.clear();
+        insertions.clear();
+        for (int index : touched) {
+            is_touched[index] = 0;
+            Place before = row_place[index];
+            Place after = place[index];
+            bool moved = before.level != after.level;
+            if (!moved && (before.level < 0 || before.order == after.order)) {
+                continue;
+            }
+
+            int id = process_ids[index];
+            if (before.level >= 0 && (after.level < 0 || !moved)) {
+                removals.push_back({before, id});
+            }
+            if (after.level >= 0) {
+                ReadyQueueEvent event = {ReadyQueueEvent::Enqueue, segment, time, id, -1, after.level,
+                                         rank(after.level, after.order)};
+                if (moved && before.level >= 0) {
+                    event.type = after.level < before.level ? ReadyQueueEvent::Promote : ReadyQueueEvent::Demote;
+                    event.from = before.level;
+                }
+                insertions.push_back(event);
+            }
+        }
+        touched.clear();
+
+        sort(removals.begin(), removals.end(), [](const pair<Place, int>& a, const pair<Place, int>& b) {
+            return a.first.level != b.first.level ? a.first.level < b.first.level : a.first.order < b.first.order;
+        });
+        sort(insertions.begin(), insertions.end(), [](const ReadyQueueEvent& a, const ReadyQueueEvent& b) {
+            return a.to != b.to ? a.to < b.to : a.position < b.position;
+        });
+        for (const pair<Place, int>& removal : removals) {
+            events.push_back({ReadyQueueEvent::Dequeue, segment, time, removal.second, removal.first.level, -1, -1});
+        }
+        events.insert(events.end(), insertions.begin(), insertions.end());
+    }
+
+    // Rebuilds the ready queues of Gantt row `segment` from the event log.
+    static pmr::vector<pmr::vector<int>> replay(const pmr::vector<ReadyQueueEvent>& events, int levels, int segment) {
+        pmr::vector<pmr::vector<int>> queues(levels, scratchResource());
+        size_t begin = 0;
+        while (begin < events.size() && events[begin].segment <= segment) {
+            size_t end = begin;
+            while (end < events.size() && events[end].segment == events[begin].segment) {
+                end++;
+            }
+
+            for (size_t e = begin; e < end; e++) {
+                if (events[e].from >= 0) {
+                    pmr::vector<int>& queue = queues[events[e].from];
+                    auto found = find(queue.begin(), queue.end(), events[e].process_id);
+                    if (found != queue.end()) {
+                        queue.erase(found);
+                    }
+                }
+            }
+            for (size_t e = begin; e < end; e++) {
+                if (events[e].to >= 0) {
+                    pmr::vector<int>& queue = queues[events[e].to];
+                    queue.insert(queue.begin() + events[e].position, events[e].process_id);
+                }
+            }
+            begin = end;
+        }
+        return queues;
+    }
+};
+
+#endif
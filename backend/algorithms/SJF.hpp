@@ -5,138 +5,158 @@
 #include <vector>
 #include <algorithm>
 #include <climits>
+#include <queue>
+#include <functional>
 #include "../Type.hpp"
 #include "../json.hpp"
+#include "EventEngine.hpp"
+#include "OutputSink.hpp"
+#include "ArrivalOrder.hpp"
+#include "ScratchArena.hpp"
 
 using namespace std;
 using json = nlohmann::json;
 
 class SJF {
 public:
-    json schedule(const vector<Process>& processes) {
-        vector<json> gantt_chart;
-        vector<json> process_stats;
+    static ScheduleLayout layout() {
+        return {ReadyLayout::Flat, 0, nullptr, false};
+    }
+
+    template <typename Sink>
+    void schedule(const vector<Process>& processes, Sink& sink) {
+        schedule(ArrivalOrder(processes), sink);
+    }
+
+    template <typename Sink>
+    void schedule(const ArrivalOrder& workload, Sink& sink) {
+        sink.begin(layout());
 
-        vector<Process> sorted_processes = processes;
-        sort(sorted_processes.begin(), sorted_processes.end(), [](const Process& a, const Process& b) {
-            return a.arrival_time < b.arrival_time;
-        });
+        const vector<Process>& sorted_processes = workload.processes();
 
-        int current_time = 0;
         int completed = 0;
         int n = sorted_processes.size();
-        vector<int> remaining_burst_time(n);
-        vector<bool> is_completed(n, false);
+        pmr::vector<int> remaining_burst_time(n, scratchResource());
 
         for (int i = 0; i < n; i++) {
             remaining_burst_time[i] = sorted_processes[i].burst_time;
         }
 
         int last_process_id = -1;
-        int idle_start_time = -1;
+        EventEngine engine(sorted_processes);
+
+        // Arrived, unfinished processes other than the running one, keyed by
+        // (remaining time, arrival order) so ties go to the earlier arrival
+        priority_queue<pair<int, int>, pmr::vector<pair<int, int>>, greater<pair<int, int>>> ready_heap(scratchResource());
+        int running_index = -1;
+
+        // The ready queue of a row lists every arrived, unfinished process in
+        // arrival order, the running one included, so it changes only when a
+        // process arrives or completes
+        int reported = 0;  // processes [0, reported) have been reported as enqueued
+        auto reportArrivals = [&]() {
+            for (; reported < engine.arrivedCount(); reported++) {
+                sink.enqueued(reported, sorted_processes[reported].p_id, 0, reported);
+            }
+        };
 
         while (completed < n) {
-            int shortest_index = -1;
-            int min_remaining_time = INT_MAX;
-
-            for (int i = 0; i < n; i++) {
-                if (sorted_processes[i].arrival_time <= current_time && !is_completed[i] &&
-                    remaining_burst_time[i] < min_remaining_time) {
-                    min_remaining_time = remaining_burst_time[i];
-                    shortest_index = i;
+            int current_time = engine.now();
+            engine.admitArrivals([&](int i) {
+                ready_heap.push({remaining_burst_time[i], i});
+                countQueueOperation(sink);
+            });
+
+            // The running process keeps the CPU unless the heap holds a smaller key
+            int shortest_index = running_index;
+            if (!ready_heap.empty() &&
+                (shortest_index == -1 ||
+                 ready_heap.top() < make_pair(remaining_burst_time[shortest_index], shortest_index))) {
+                if (shortest_index != -1) {
+                    ready_heap.push({remaining_burst_time[shortest_index], shortest_index});
+                    countQueueOperation(sink);
                 }
+                shortest_index = ready_heap.top().second;
+                ready_heap.pop();
+                countSelection(sink);
+                countQueueOperation(sink);
             }
+            running_index = shortest_index;
 
             if (shortest_index == -1) {
                 if (last_process_id != -1 && last_process_id != -2) {
-                    gantt_chart.back()["end_time"] = current_time;
-                    idle_start_time = current_time;
-                    gantt_chart.push_back({
-                        {"process_id", -1},
-                        {"start_time", current_time},
-                        {"ready_queue", vector<int>()}
-                    });
+                    sink.endSegment(current_time);
+                    sink.segment(-1, current_time);
                     last_process_id = -2;
                 }
-                current_time++;
+                // Nothing is ready, so skip the idle stretch in one step
+                engine.jumpTo(engine.nextArrivalTime());
                 continue;
             } else {
                 if (last_process_id == -2) {
-                    gantt_chart.back()["end_time"] = current_time;
+                    sink.endSegment(current_time);
                     last_process_id = -1;  // Reset to prepare for new process
                 }
             }
 
             if (last_process_id != sorted_processes[shortest_index].p_id) {
                 if (last_process_id >= 0) {  // Was running a real process
-                    gantt_chart.back()["end_time"] = current_time;
+                    sink.endSegment(current_time);
                 }
-                gantt_chart.push_back({
-                    {"process_id", sorted_processes[shortest_index].p_id},
-                    {"start_time", current_time},
-                    {"ready_queue", vector<int>()}
-                });
-                for (int i = 0; i < n; i++) {
-                    if (!is_completed[i] && sorted_processes[i].arrival_time <= current_time) {
-                        gantt_chart.back()["ready_queue"].push_back(sorted_processes[i].p_id);
-                    }
+                reportArrivals();
+                sink.segment(sorted_processes[shortest_index].p_id, current_time);
+                if (sink.wantsReadyLists()) {
+                    engine.forEachActive([&](int i) {
+                        sink.ready(sorted_processes[i].p_id);
+                    });
                 }
             }
 
             last_process_id = sorted_processes[shortest_index].p_id;
 
-            // Execute the process for 1 unit of time
-            remaining_burst_time[shortest_index]--;
-            current_time++;
-
-            // Check if a new process arrives during execution
-            for (int i = 0; i < n; i++) {
-                if (sorted_processes[i].arrival_time == current_time && !is_completed[i]) {
-                    // Split the current Gantt chart entry
-                    gantt_chart.back()["end_time"] = current_time;
-                    gantt_chart.push_back({
-                        {"process_id", sorted_processes[shortest_index].p_id},
-                        {"start_time", current_time},
-                        {"ready_queue", vector<int>()}
+            // The running process only gets shorter, so it keeps the CPU until
+            // it completes or a new process arrives
+            int run_time = min(remaining_burst_time[shortest_index], engine.ticksUntilNextArrival());
+            remaining_burst_time[shortest_index] -= run_time;
+            engine.advance(run_time);
+            current_time = engine.now();
+
+            // A process arriving now splits the current Gantt chart entry
+            if (engine.arrivalAtNow()) {
+                sink.endSegment(current_time);
+                reportArrivals();
+                sink.segment(sorted_processes[shortest_index].p_id, current_time);
+                if (sink.wantsReadyLists()) {
+                    engine.forEachActive([&](int j) {
+                        sink.ready(sorted_processes[j].p_id);
                     });
-                    for (int j = 0; j < n; j++) {
-                        if (!is_completed[j] && sorted_processes[j].arrival_time <= current_time) {
-                            gantt_chart.back()["ready_queue"].push_back(sorted_processes[j].p_id);
-                        }
-                    }
-                    break;
                 }
             }
 
             // If the process is completed
             if (remaining_burst_time[shortest_index] == 0) {
-                is_completed[shortest_index] = true;
+                engine.finish(shortest_index);
+                sink.dequeued(shortest_index);
+                running_index = -1;
                 completed++;
 
                 int completion_time = current_time;
                 int turnaround_time = completion_time - sorted_processes[shortest_index].arrival_time;
                 int waiting_time = turnaround_time - sorted_processes[shortest_index].burst_time;
 
-                process_stats.push_back({
-                    {"process_id", sorted_processes[shortest_index].p_id},
-                    {"arrival_time", sorted_processes[shortest_index].arrival_time},
-                    {"burst_time", sorted_processes[shortest_index].burst_time},
-                    {"priority", sorted_processes[shortest_index].priority},
-                    {"completion_time", completion_time},
-                    {"turnaround_time", turnaround_time},
-                    {"waiting_time", waiting_time}
-                });
+                sink.stat({sorted_processes[shortest_index].p_id, sorted_processes[shortest_index].arrival_time,
+                           sorted_processes[shortest_index].burst_time, sorted_processes[shortest_index].priority,
+                           completion_time, turnaround_time, waiting_time, -1, 0});
             }
         }
 
-        if (!gantt_chart.empty()) {
-            gantt_chart.back()["end_time"] = current_time;
-        }
+        sink.endSegment(engine.now());
+    }
 
-        json result;
-        result["gantt_chart"] = gantt_chart;
-        result["process_stats"] = process_stats;
-        return result;
+    json schedule(const vector<Process>& processes) {
+        JsonSink sink;
+        schedule(processes, sink);
+        return sink.result();
     }
 };
 
@@ -5,159 +5,198 @@
 #include <vector>
 #include <algorithm>
 #include <climits>
-#include <cfloat>
 #include "../Type.hpp"
 #include "../json.hpp"
+#include "EventEngine.hpp"
+#include "OutputSink.hpp"
+#include "ArrivalOrder.hpp"
+#include "ScratchArena.hpp"
+#include "AgingReadyQueue.hpp"
 
 using namespace std;
 using json = nlohmann::json;
 
 class SJF_Aging {
 public:
-    json schedule(const vector<Process>& processes, int aging_threshold = 50) {
-        vector<json> gantt_chart;
-        vector<json> process_stats;
+    static ScheduleLayout layout() {
+        return {ReadyLayout::Flat, 0, nullptr, true};
+    }
 
-        // Calculate aging factor based on threshold (0-100)
-        // Higher threshold means slower aging, lower threshold means faster aging
-        const float AGING_FACTOR = static_cast<float>(aging_threshold) / 100.0f;
+    template <typename Sink>
+    void schedule(const vector<Process>& processes, int aging_threshold, Sink& sink) {
+        schedule(ArrivalOrder(processes), aging_threshold, sink);
+    }
 
-        vector<Process> sorted_processes = processes;
-        sort(sorted_processes.begin(), sorted_processes.end(), [](const Process& a, const Process& b) {
-            return a.arrival_time < b.arrival_time;
-        });
+    template <typename Sink>
+    void schedule(const ArrivalOrder& workload, int aging_threshold, Sink& sink) {
+        sink.begin(layout());
+
+        // Aging factor is aging_threshold / 100 per tick waited (threshold 0-100).
+        // Aged times are compared in hundredths of a time unit, see AgingReadyQueue.
+        const vector<Process>& sorted_processes = workload.processes();
 
-        int current_time = 0;
         int completed = 0;
         int n = sorted_processes.size();
-        vector<int> remaining_burst_time(n);
-        vector<int> wait_time(n, 0);
-        vector<bool> is_completed(n, false);
+        pmr::vector<int> remaining_burst_time(n, scratchResource());
+        pmr::vector<int> wait_time(n, 0, scratchResource());        // ticks waited up to enqueue_time
+        pmr::vector<int> enqueue_time(n, 0, scratchResource());
 
         for (int i = 0; i < n; i++) {
             remaining_burst_time[i] = sorted_processes[i].burst_time;
         }
 
         int last_process_id = -1;
+        EventEngine engine(sorted_processes);
+        AgingReadyQueue waiting(aging_threshold);
+        int running_index = -1;
+        bool ran_last_tick = false;
+
+        // The ready queue of a row lists the arrived, unfinished processes in
+        // arrival order, leaving out the one the row runs
+        int reported = 0;        // processes [0, reported) have been reported as enqueued
+        int left_out = -1;       // the process the latest row runs
+        auto reportReady = [&](int running) {
+            for (; reported < engine.arrivedCount(); reported++) {
+                sink.enqueued(reported, sorted_processes[reported].p_id, 0, reported);
+            }
+            if (left_out != running) {
+                if (left_out != -1 && remaining_burst_time[left_out] > 0) {
+                    sink.enqueued(left_out, sorted_processes[left_out].p_id, 0, left_out);
+                }
+                sink.dequeued(running);
+                left_out = running;
+            }
+        };
+
+        auto enqueue = [&](int i, int now) {
+            enqueue_time[i] = now;
+            waiting.push(i, remaining_burst_time[i], wait_time[i], now);
+            countQueueOperation(sink);
+        };
 
         while (completed < n) {
-            int selected_index = -1;
-            float min_adjusted_remaining_time = FLT_MAX;
-
-            for (int i = 0; i < n; i++) {
-                if (sorted_processes[i].arrival_time <= current_time && !is_completed[i]) {
-                    float adjusted_time = remaining_burst_time[i] - (AGING_FACTOR * wait_time[i]);
-                    
-                    adjusted_time = max(adjusted_time, 0.5f);
-
-                    if (adjusted_time < min_adjusted_remaining_time) {
-                        min_adjusted_remaining_time = adjusted_time;
-                        selected_index = i;
+            int current_time = engine.now();
+
+            // A process arriving right after a busy tick has already been
+            // credited with that tick
+            engine.admitArrivals([&](int i) {
+                wait_time[i] = ran_last_tick ? 1 : 0;
+                enqueue(i, current_time);
+            });
+
+            int selected_index = running_index;
+            if (!waiting.empty()) {
+                pair<long long, int> best_waiting = waiting.top(current_time);
+                if (selected_index == -1 ||
+                    best_waiting < make_pair(AgingReadyQueue::agedTime(remaining_burst_time[selected_index],
+                                                                       wait_time[selected_index], aging_threshold),
+                                             selected_index)) {
+                    if (selected_index != -1) {
+                        enqueue(selected_index, current_time);
                     }
+                    selected_index = waiting.pop(current_time);
+                    countSelection(sink);
+                    countQueueOperation(sink);
+                    wait_time[selected_index] += current_time - enqueue_time[selected_index];
                 }
             }
+            running_index = selected_index;
 
             if (selected_index == -1) {
                 if (last_process_id != -1 && last_process_id != -2) {
-                    gantt_chart.back()["end_time"] = current_time;
-                    gantt_chart.push_back({
-                        {"process_id", -1},
-                        {"start_time", current_time},
-                        {"ready_queue", json::array()}
-                    });
+                    sink.endSegment(current_time);
+                    sink.segment(-1, current_time);
                     last_process_id = -2;
                 }
-                current_time++;
+                engine.jumpTo(engine.nextArrivalTime());
+                ran_last_tick = false;
                 continue;
             } else {
                 if (last_process_id == -2) { 
-                    gantt_chart.back()["end_time"] = current_time;
+                    sink.endSegment(current_time);
                     last_process_id = -1;
                 }
             }
 
             if (last_process_id != sorted_processes[selected_index].p_id) {
                 if (last_process_id >= 0) {
-                    gantt_chart.back()["end_time"] = current_time;
+                    sink.endSegment(current_time);
                 }
-                gantt_chart.push_back({
-                    {"process_id", sorted_processes[selected_index].p_id},
-                    {"start_time", current_time},
-                    {"ready_queue", json::array()}
-                });
-
-                for (int i = 0; i < n; i++) {
-                    if (!is_completed[i] && sorted_processes[i].arrival_time <= current_time && 
-                        i != selected_index) {
-                        gantt_chart.back()["ready_queue"].push_back(sorted_processes[i].p_id);
-                    }
+                reportReady(selected_index);
+                sink.segment(sorted_processes[selected_index].p_id, current_time);
+                if (sink.wantsReadyLists()) {
+                    engine.forEachActive([&](int i) {
+                        if (i != selected_index) {
+                            sink.ready(sorted_processes[i].p_id);
+                        }
+                    });
                 }
             }
 
             last_process_id = sorted_processes[selected_index].p_id;
 
-            remaining_burst_time[selected_index]--;
-            current_time++;
-
-            for (int i = 0; i < n; i++) {
-                if (!is_completed[i] && sorted_processes[i].arrival_time <= current_time && i != selected_index) {
-                    wait_time[i]++;
+            // Run until the next arrival, completion or aging deadline. Waiting
+            // processes age at the same rate, so only the one with the smallest
+            // aged time can overtake the running process, and only once it ages
+            // faster than the running process shrinks (threshold above 100). The
+            // floor is an event too: a process reaching it ties at 0.5.
+            int run_time = min(remaining_burst_time[selected_index], engine.ticksUntilNextArrival());
+            if (!waiting.empty()) {
+                run_time = min(run_time, waiting.ticksUntilFloor(current_time));
+
+                long long running_aged = AgingReadyQueue::agedTime(remaining_burst_time[selected_index],
+                                                                   wait_time[selected_index], aging_threshold);
+                if (aging_threshold > AgingReadyQueue::SCALE && running_aged > AgingReadyQueue::FLOOR &&
+                    waiting.hasUnfloored(current_time)) {
+                    pair<long long, int> contender = waiting.unflooredTop(current_time);
+                    long long gap = contender.first - running_aged;
+                    long long closing_rate = aging_threshold - AgingReadyQueue::SCALE;
+                    long long ticks = contender.second < selected_index ? (gap + closing_rate - 1) / closing_rate
+                                                                         : gap / closing_rate + 1;
+                    run_time = static_cast<int>(min(static_cast<long long>(run_time), max(ticks, 1LL)));
                 }
             }
 
-            bool new_arrival = false;
-            for (int i = 0; i < n; i++) {
-                if (sorted_processes[i].arrival_time == current_time && !is_completed[i]) {
-                    new_arrival = true;
-                    break;
-                }
-            }
-            
-            if (new_arrival) {
-                gantt_chart.back()["end_time"] = current_time;
-                gantt_chart.push_back({
-                    {"process_id", sorted_processes[selected_index].p_id},
-                    {"start_time", current_time},
-                    {"ready_queue", json::array()}
-                });
-                
-                for (int j = 0; j < n; j++) {
-                    if (!is_completed[j] && sorted_processes[j].arrival_time <= current_time && 
-                        j != selected_index) {
-                        gantt_chart.back()["ready_queue"].push_back(sorted_processes[j].p_id);
-                    }
+            remaining_burst_time[selected_index] -= run_time;
+            engine.advance(run_time);
+            current_time = engine.now();
+            ran_last_tick = true;
+
+            if (engine.arrivalAtNow()) {
+                sink.endSegment(current_time);
+                reportReady(selected_index);
+                sink.segment(sorted_processes[selected_index].p_id, current_time);
+                if (sink.wantsReadyLists()) {
+                    engine.forEachActive([&](int j) {
+                        if (j != selected_index) {
+                            sink.ready(sorted_processes[j].p_id);
+                        }
+                    });
                 }
             }
 
             if (remaining_burst_time[selected_index] == 0) {
-                is_completed[selected_index] = true;
+                engine.finish(selected_index);
+                running_index = -1;
                 completed++;
 
                 int completion_time = current_time;
                 int turnaround_time = completion_time - sorted_processes[selected_index].arrival_time;
                 int waiting_time = turnaround_time - sorted_processes[selected_index].burst_time;
 
-                process_stats.push_back({
-                    {"process_id", sorted_processes[selected_index].p_id},
-                    {"arrival_time", sorted_processes[selected_index].arrival_time},
-                    {"burst_time", sorted_processes[selected_index].burst_time},
-                    {"priority", sorted_processes[selected_index].priority},
-                    {"completion_time", completion_time},
-                    {"turnaround_time", turnaround_time},
-                    {"waiting_time", waiting_time},
-                    {"aging_wait_time", wait_time[selected_index]}
-                });
+                sink.stat({sorted_processes[selected_index].p_id, sorted_processes[selected_index].arrival_time,
+                           sorted_processes[selected_index].burst_time, sorted_processes[selected_index].priority,
+                           completion_time, turnaround_time, waiting_time, -1, wait_time[selected_index]});
             }
         }
 
-        if (!gantt_chart.empty()) {
-            gantt_chart.back()["end_time"] = current_time;
-        }
+        sink.endSegment(engine.now());
+    }
 
-        json result;
-        result["gantt_chart"] = gantt_chart;
-        result["process_stats"] = process_stats;
-        return result;
+    json schedule(const vector<Process>& processes, int aging_threshold = 50) {
+        JsonSink sink;
+        schedule(processes, aging_threshold, sink);
+        return sink.result();
     }
 };
 
@@ -0,0 +1,80 @@
+#ifndef SCHEDULE_PROFILE_HPP
+#define SCHEDULE_PROFILE_HPP
+#pragma once
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+using namespace std;
+
+// Counters of one scheduler run, filled in only when the run reports to a
+// ProfilingSink (OutputSink.hpp). Schedulers count through countSelection()
+// and countQueueOperation(), which are empty for every other sink, so an
+// unprofiled run compiles to the same code as before.
+struct ScheduleProfile {
+    uint64_t selections = 0;        // times the scheduler picked the process to run
+    uint64_t queue_operations = 0;  // insertions into and removals from ready structures
+    uint64_t snapshots = 0;         // Gantt rows that reported a ready queue
+    uint64_t snapshot_entries = 0;  // processes listed in those ready queues
+    uint64_t segments = 0;          // Gantt rows
+};
+
+// Whether a sink carries a ScheduleProfile named profile
+template <typename Sink, typename = void>
+struct ProfilesSchedule : false_type {};
+
+template <typename Sink>
+struct ProfilesSchedule<Sink, void_t<decltype(declval<Sink&>().profile)>> : true_type {};
+
+template <typename Sink>
+inline void countSelection(Sink& sink) {
+    if constexpr (ProfilesSchedule<Sink>::value) {
+        sink.profile.selections++;
+    }
+}
+
+template <typename Sink>
+inline void countQueueOperation(Sink& sink, uint64_t count = 1) {
+    if constexpr (ProfilesSchedule<Sink>::value) {
+        sink.profile.queue_operations += count;
+    }
+}
+
+// Heap allocations of the calling thread. The server's replacement
+// operator new (main.cpp) adds to count only while counting is set, which an
+// AllocationCount does for a profiled request; programs without it always
+// read 0.
+struct AllocationCounter {
+    bool counting = false;
+    uint64_t count = 0;
+};
+
+inline AllocationCounter& threadAllocations() {
+    static thread_local AllocationCounter counter;
+    return counter;
+}
+
+// Counts the calling thread's heap allocations while it exists
+class AllocationCount {
+private:
+    uint64_t start;
+    bool was_counting;
+
+public:
+    AllocationCount() : start(threadAllocations().count), was_counting(threadAllocations().counting) {
+        threadAllocations().counting = true;
+    }
+
+    AllocationCount(const AllocationCount&) = delete;
+    AllocationCount& operator=(const AllocationCount&) = delete;
+
+    ~AllocationCount() {
+        threadAllocations().counting = was_counting;
+    }
+
+    uint64_t count() const {
+        return threadAllocations().count - start;
+    }
+};
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef SCRATCH_ARENA_HPP
+#define SCRATCH_ARENA_HPP
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+
+using namespace std;
+
+// Bump allocator for the working state of scheduler runs on one thread.
+//
+// Memory comes from a few large blocks and is handed out by advancing a
+// cursor; freeing is a no-op. reset() rewinds the cursor and merges the blocks
+// a run needed into one, so the next run of the same size or smaller on this
+// thread makes no heap allocation at all. Threads keep their arena between
+// requests, up to retained_limit bytes.
+class ScratchArena : public pmr::memory_resource {
+private:
+    struct Block {
+        Block* next;
+        size_t size;  // usable bytes after the header
+    };
+
+    static constexpr size_t header_size = (sizeof(Block) + alignof(max_align_t) - 1) / alignof(max_align_t) *
+                                          alignof(max_align_t);
+    static constexpr size_t first_block = 64 * 1024;
+    static constexpr size_t retained_limit = 32 * 1024 * 1024;
+
+    Block* blocks = nullptr;  // newest first; the cursor is in the newest
+    uintptr_t cursor = 0;
+    uintptr_t limit = 0;
+    size_t reserved = 0;      // usable bytes of all blocks
+
+    static uintptr_t dataOf(Block* block) {
+        return reinterpret_cast<uintptr_t>(block) + header_size;
+    }
+
+    void addBlock(size_t size) {
+        Block* block = static_cast<Block*>(::operator new(header_size + size));
+        block->next = blocks;
+        block->size = size;
+        blocks = block;
+        cursor = dataOf(block);
+        limit = cursor + size;
+        reserved += size;
+    }
+
+    void release() {
+        while (blocks != nullptr) {
+            Block* next = blocks->next;
+            ::operator delete(blocks);
+            blocks = next;
+        }
+        cursor = limit = 0;
+        reserved = 0;
+    }
+
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        uintptr_t start = (cursor + alignment - 1) & ~(uintptr_t(alignment) - 1);
+        if (blocks == nullptr || start > limit || limit - start < bytes) {
+            // Each new block at least doubles the arena
+            size_t size = bytes + alignment;
+            size = size > reserved ? size : reserved;
+            addBlock(size > first_block ? size : first_block);
+            start = (cursor + alignment - 1) & ~(uintptr_t(alignment) - 1);
+        }
+        cursor = start + bytes;
+        return reinterpret_cast<void*>(start);
+    }
+
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(const pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+public:
+    ScratchArena() = default;
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    ~ScratchArena() override {
+        release();
+    }
+
+    // The calling thread's arena
+    static ScratchArena& local() {
+        thread_local ScratchArena arena;
+        return arena;
+    }
+
+    // Bytes the arena holds on to
+    size_t capacity() const {
+        return reserved;
+    }
+
+    // Frees everything allocated so far at once
+    void reset() {
+        size_t total = reserved;
+        if (blocks != nullptr && blocks->next == nullptr && total <= retained_limit) {
+            cursor = dataOf(blocks);
+            return;
+        }
+        release();
+        if (total > 0 && total <= retained_limit) {
+            addBlock(total);
+        }
+    }
+};
+
+// Routes scratchResource() to the thread's arena while it exists. A pool
+// recycles what a run frees and returns (deque chunks, hash nodes), so only
+// growth reaches the arena. Scopes nest, and the arena is reset when the
+// outermost one ends: nothing allocated in a scope may outlive it, or move to
+// another thread.
+class ScratchScope {
+private:
+    pmr::unsynchronized_pool_resource pool;
+    ScratchScope* outer;
+
+    static ScratchScope*& current() {
+        thread_local ScratchScope* scope = nullptr;
+        return scope;
+    }
+
+public:
+    // Only blocks up to a deque chunk are pooled; vectors grow in the arena
+    ScratchScope() : pool(pmr::pool_options{0, 512}, &ScratchArena::local()), outer(current()) {
+        current() = this;
+    }
+
+    ScratchScope(const ScratchScope&) = delete;
+    ScratchScope& operator=(const ScratchScope&) = delete;
+
+    ~ScratchScope() {
+        current() = outer;
+        pool.release();
+        if (outer == nullptr) {
+            ScratchArena::local().reset();
+        }
+    }
+
+    static pmr::memory_resource* active() {
+        return current() != nullptr ? &current()->pool : nullptr;
+    }
+};
+
+// Where schedulers allocate the state of a run: the innermost ScratchScope of
+// the calling thread, or the heap outside of one
+inline pmr::memory_resource* scratchResource() {
+    pmr::memory_resource* scope = ScratchScope::active();
+    return scope != nullptr ? scope : pmr::new_delete_resource();
+}
+
+#endif
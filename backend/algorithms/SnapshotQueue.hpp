@@ -0,0 +1,69 @@
+#ifndef SNAPSHOT_QUEUE_HPP
+#define SNAPSHOT_QUEUE_HPP
+#pragma once
+#include <vector>
+#include <cstddef>
+#include "ScratchArena.hpp"
+
+using namespace std;
+
+// FIFO queue whose contents can be snapshotted in O(1).
+//
+// Every push appends to one append-only log and a pop only advances the head
+// offset, so the queue is always the log range [head, tail). Entries are never
+// overwritten. A snapshot is therefore just the current (head, tail) pair, and
+// all snapshots share the log. They are expanded only when the caller walks one
+// with forEach(), typically when the Gantt chart is serialized.
+class SnapshotQueue {
+public:
+    struct Snapshot {
+        size_t head;
+        size_t tail;
+    };
+
+private:
+    pmr::vector<int> log;
+    size_t head;
+
+public:
+    SnapshotQueue() : log(scratchResource()), head(0) {}
+
+    bool empty() const {
+        return head == log.size();
+    }
+
+    size_t size() const {
+        return log.size() - head;
+    }
+
+    void push(int value) {
+        log.push_back(value);
+    }
+
+    int front() const {
+        return log[head];
+    }
+
+    void pop() {
+        head++;
+    }
+
+    Snapshot snapshot() const {
+        return {head, log.size()};
+    }
+
+    // The entry at a log offset; a snapshot's entries are those at [head, tail)
+    int at(size_t offset) const {
+        return log[offset];
+    }
+
+    // Calls visit(value) for every entry of a snapshot, front to back.
+    template <typename Visit>
+    void forEach(const Snapshot& snap, Visit visit) const {
+        for (size_t i = snap.head; i < snap.tail; i++) {
+            visit(log[i]);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,341 @@
+#ifndef STREAM_WRITERS_HPP
+#define STREAM_WRITERS_HPP
+#pragma once
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include "../json.hpp"
+
+using namespace std;
+using json = nlohmann::json;
+
+// Token writers for the streaming output sinks. Each appends one encoding of
+// the same document model to a string: objects and arrays whose sizes are
+// known up front, plus open arrays whose length is only patched in at the end.
+// Integers and floats use the same compact encodings nlohmann picks for its
+// to_cbor() and to_msgpack(); open arrays always use the 32-bit length form.
+
+// Compact JSON text, as dump() writes it. Keys must not need escaping.
+class JsonTextWriter {
+private:
+    string& out;
+    vector<char> first;  // per open container: nothing written into it yet
+    bool after_key = false;
+
+    void separate() {
+        if (after_key) {
+            after_key = false;
+            return;
+        }
+        if (!first.empty()) {
+            if (!first.back()) {
+                out += ',';
+            }
+            first.back() = 0;
+        }
+    }
+
+public:
+    explicit JsonTextWriter(string& buffer) : out(buffer) {}
+
+    void reset() {
+        first.clear();
+        after_key = false;
+    }
+
+    void beginObject(size_t) {
+        separate();
+        out += '{';
+        first.push_back(1);
+    }
+
+    void endObject() {
+        out += '}';
+        first.pop_back();
+    }
+
+    void beginArray(size_t) {
+        separate();
+        out += '[';
+        first.push_back(1);
+    }
+
+    void endArray() {
+        out += ']';
+        first.pop_back();
+    }
+
+    size_t beginOpenArray() {
+        beginArray(0);
+        return 0;
+    }
+
+    void endOpenArray(size_t, size_t) {
+        endArray();
+    }
+
+    void key(const char* name) {
+        separate();
+        out += '"';
+        out += name;
+        out += "\":";
+        after_key = true;
+    }
+
+    void integer(long long value) {
+        separate();
+        char digits[24];
+        auto written = to_chars(digits, digits + sizeof(digits), value);
+        out.append(digits, written.ptr);
+    }
+
+    void number(double value) {
+        separate();
+        out += json(value).dump();
+    }
+
+    void text(const string& value) {
+        separate();
+        // Plain ASCII needs no escaping; anything else is left to dump()
+        bool plain = all_of(value.begin(), value.end(), [](char c) {
+            return c >= 0x20 && c != '"' && c != '\\';
+        });
+        if (plain) {
+            out += '"';
+            out += value;
+            out += '"';
+        } else {
+            out += json(value).dump();
+        }
+    }
+};
+
+// Whether a double survives a round trip through float
+inline bool fitsFloat(double value) {
+    return value >= numeric_limits<float>::lowest() && value <= numeric_limits<float>::max() &&
+           static_cast<double>(static_cast<float>(value)) == value;
+}
+
+inline uint32_t floatBits(double value) {
+    float narrow = static_cast<float>(value);
+    uint32_t bits;
+    memcpy(&bits, &narrow, sizeof(bits));
+    return bits;
+}
+
+inline uint64_t doubleBits(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// CBOR (RFC 8949)
+class CborWriter {
+private:
+    string& out;
+
+    void head(uint8_t major, uint64_t value) {
+        uint8_t type = static_cast<uint8_t>(major << 5);
+        if (value < 24) {
+            out += static_cast<char>(type | value);
+        } else if (value <= 0xFF) {
+            out += static_cast<char>(type | 24);
+            out += static_cast<char>(value);
+        } else if (value <= 0xFFFF) {
+            out += static_cast<char>(type | 25);
+            appendBigEndian(value, 2);
+        } else if (value <= 0xFFFFFFFF) {
+            out += static_cast<char>(type | 26);
+            appendBigEndian(value, 4);
+        } else {
+            out += static_cast<char>(type | 27);
+            appendBigEndian(value, 8);
+        }
+    }
+
+    void appendBigEndian(uint64_t value, int bytes) {
+        for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8) {
+            out += static_cast<char>((value >> shift) & 0xFF);
+        }
+    }
+
+public:
+    explicit CborWriter(string& buffer) : out(buffer) {}
+
+    void reset() {}
+
+    void beginObject(size_t size) {
+        head(5, size);
+    }
+
+    void endObject() {}
+
+    void beginArray(size_t size) {
+        head(4, size);
+    }
+
+    void endArray() {}
+
+    size_t beginOpenArray() {
+        out += static_cast<char>(0x9A);  // array, 32-bit length follows
+        size_t at = out.size();
+        out.append(4, '\0');
+        return at;
+    }
+
+    void endOpenArray(size_t at, size_t size) {
+        for (int i = 0; i < 4; i++) {
+            out[at + i] = static_cast<char>((size >> (24 - 8 * i)) & 0xFF);
+        }
+    }
+
+    void key(const char* name) {
+        text(name);
+    }
+
+    void integer(long long value) {
+        if (value >= 0) {
+            head(0, static_cast<uint64_t>(value));
+        } else {
+            head(1, static_cast<uint64_t>(-1 - value));
+        }
+    }
+
+    // Single precision when that is exact, as nlohmann does; values are finite
+    void number(double value) {
+        if (fitsFloat(value)) {
+            out += static_cast<char>(0xFA);
+            appendBigEndian(floatBits(value), 4);
+        } else {
+            out += static_cast<char>(0xFB);
+            appendBigEndian(doubleBits(value), 8);
+        }
+    }
+
+    void text(const string& value) {
+        head(3, value.size());
+        out += value;
+    }
+};
+
+// MessagePack
+class MsgPackWriter {
+private:
+    string& out;
+
+    void appendBigEndian(uint64_t value, int bytes) {
+        for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8) {
+            out += static_cast<char>((value >> shift) & 0xFF);
+        }
+    }
+
+    // fix-size form below fix_limit, else the 16- or 32-bit form
+    void sized(size_t size, uint8_t fix_tag, size_t fix_limit, uint8_t tag16, uint8_t tag32) {
+        if (size < fix_limit) {
+            out += static_cast<char>(fix_tag | size);
+        } else if (size <= 0xFFFF) {
+            out += static_cast<char>(tag16);
+            appendBigEndian(size, 2);
+        } else {
+            out += static_cast<char>(tag32);
+            appendBigEndian(size, 4);
+        }
+    }
+
+public:
+    explicit MsgPackWriter(string& buffer) : out(buffer) {}
+
+    void reset() {}
+
+    void beginObject(size_t size) {
+        sized(size, 0x80, 16, 0xDE, 0xDF);
+    }
+
+    void endObject() {}
+
+    void beginArray(size_t size) {
+        sized(size, 0x90, 16, 0xDC, 0xDD);
+    }
+
+    void endArray() {}
+
+    size_t beginOpenArray() {
+        out += static_cast<char>(0xDD);  // array 32
+        size_t at = out.size();
+        out.append(4, '\0');
+        return at;
+    }
+
+    void endOpenArray(size_t at, size_t size) {
+        for (int i = 0; i < 4; i++) {
+            out[at + i] = static_cast<char>((size >> (24 - 8 * i)) & 0xFF);
+        }
+    }
+
+    void key(const char* name) {
+        text(name);
+    }
+
+    void integer(long long value) {
+        if (value >= 0) {
+            if (value < 128) {
+                out += static_cast<char>(value);
+            } else if (value <= 0xFF) {
+                out += static_cast<char>(0xCC);
+                appendBigEndian(value, 1);
+            } else if (value <= 0xFFFF) {
+                out += static_cast<char>(0xCD);
+                appendBigEndian(value, 2);
+            } else if (value <= 0xFFFFFFFFLL) {
+                out += static_cast<char>(0xCE);
+                appendBigEndian(value, 4);
+            } else {
+                out += static_cast<char>(0xCF);
+                appendBigEndian(value, 8);
+            }
+        } else if (value >= -32) {
+            out += static_cast<char>(value);
+        } else if (value >= -128) {
+            out += static_cast<char>(0xD0);
+            appendBigEndian(static_cast<uint8_t>(value), 1);
+        } else if (value >= -32768) {
+            out += static_cast<char>(0xD1);
+            appendBigEndian(static_cast<uint16_t>(value), 2);
+        } else if (value >= INT32_MIN) {
+            out += static_cast<char>(0xD2);
+            appendBigEndian(static_cast<uint32_t>(value), 4);
+        } else {
+            out += static_cast<char>(0xD3);
+            appendBigEndian(static_cast<uint64_t>(value), 8);
+        }
+    }
+
+    void number(double value) {
+        if (fitsFloat(value)) {
+            out += static_cast<char>(0xCA);
+            appendBigEndian(floatBits(value), 4);
+        } else {
+            out += static_cast<char>(0xCB);
+            appendBigEndian(doubleBits(value), 8);
+        }
+    }
+
+    void text(const string& value) {
+        if (value.size() < 32) {
+            out += static_cast<char>(0xA0 | value.size());
+        } else if (value.size() <= 0xFF) {
+            out += static_cast<char>(0xD9);
+            appendBigEndian(value.size(), 1);
+        } else {
+            sized(value.size(), 0, 0, 0xDA, 0xDB);
+        }
+        out += value;
+    }
+};
+
+#endif
@@ -1,4 +1,26 @@
 #include "APIHandler/APIHandler.hpp"
+#include <cstdlib>
+#include <new>
+
+// Counts the allocations of profiled requests (see AllocationCount). Memory
+// still comes from malloc, so the default operator delete releases it.
+void* operator new(std::size_t size)
+{
+    AllocationCounter& counter = threadAllocations();
+    if (counter.counting) {
+        counter.count++;
+    }
+    while (true) {
+        if (void* block = std::malloc(size > 0 ? size : 1)) {
+            return block;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
 
 int main()
 {
@@ -6,6 +28,6 @@ int main()
     APIHandler api;
     // Start the server
     api.run(18080, true);
-    
+
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,631 @@
+// Benchmarks every scheduler's schedule() on generated workloads of 10^2 to
+// 10^6 processes and prints one CSV row per case: time per process, peak
+// heap use, heap allocations of a warm run and output size. Save the output and pass it back with
+// --baseline to compare a change against it. With --phases, each case is
+// instead split into the phases of a request, timed separately. With
+// --check-delta, the delta-format events of each case are compared with
+// those ReadyQueueDelta derives from the full ready queue of every row.
+//
+//   g++ -std=c++17 -O2 -o scheduler_bench scheduler_bench.cpp
+//   ./scheduler_bench > baseline.csv
+//   ./scheduler_bench --baseline baseline.csv
+//   ./scheduler_bench --phases
+//   ./scheduler_bench --check-delta --max-count 1000
+
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "algorithms/FCFS.hpp"
+#include "algorithms/SJF.hpp"
+#include "algorithms/SJF_Aging.hpp"
+#include "algorithms/RR.hpp"
+#include "algorithms/Priority.hpp"
+#include "algorithms/MLQ.hpp"
+#include "algorithms/MLFQ.hpp"
+#include "algorithms/MLQ_Aging.hpp"
+#include "WorkloadGenerator.hpp"
+
+// Heap accounting: every allocation carries its size in a header, so the
+// live byte count and its peak are exact
+static size_t live_bytes = 0;
+static size_t peak_bytes = 0;
+static size_t allocation_count = 0;
+static const size_t header_size = alignof(max_align_t);
+
+void* operator new(size_t size) {
+    char* block = static_cast<char*>(malloc(size + header_size));
+    if (!block) {
+        throw bad_alloc();
+    }
+    memcpy(block, &size, sizeof(size));
+    allocation_count++;
+    live_bytes += size;
+    peak_bytes = max(peak_bytes, live_bytes);
+    return block + header_size;
+}
+
+void operator delete(void* pointer) noexcept {
+    if (!pointer) {
+        return;
+    }
+    // The header is found by address, as the compiler cannot see that the
+    // object was allocated past it
+    void* block = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(pointer) - header_size);
+    size_t size;
+    memcpy(&size, block, sizeof(size));
+    live_bytes -= size;
+    free(block);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+// A workload shape: the generator spec per process count, and the quantum
+// handed to the time-sliced schedulers
+struct Shape {
+    string name;
+    WorkloadSpec spec;
+    int quantum;
+};
+
+static vector<Shape> shapes() {
+    vector<Shape> result;
+
+    // Everything arrives at t=0, so the ready queue holds the whole workload
+    WorkloadSpec simultaneous;
+    simultaneous.arrival_rate = 1e9;
+    result.push_back({"simultaneous", simultaneous, 4});
+
+    // Poisson arrivals at 90% load
+    WorkloadSpec staggered;
+    staggered.arrival_rate = 0.09;
+    staggered.priority_weights = {1, 1, 1};
+    result.push_back({"staggered", staggered, 4});
+
+    // Heavy-tailed bursts averaging 1000 time units, at 90% load
+    WorkloadSpec long_bursts;
+    long_bursts.bursts = "pareto";
+    long_bursts.burst_mean = 1000;
+    long_bursts.arrival_rate = 0.0009;
+    long_bursts.priority_weights = {1, 1, 1};
+    result.push_back({"long_bursts", long_bursts, 4});
+
+    // Bursts of about 50 cut into single time units
+    WorkloadSpec tiny_quantum;
+    tiny_quantum.burst_mean = 50;
+    tiny_quantum.arrival_rate = 0.018;
+    tiny_quantum.priority_weights = {1, 1, 1};
+    result.push_back({"tiny_quantum", tiny_quantum, 1});
+
+    return result;
+}
+
+static const vector<string> algorithms = {
+    "FCFS", "MLFQ", "MLQ", "MLQ_Aging", "Priority", "RR", "SJF", "SJF_Aging"
+};
+
+// Same parameters as the API defaults, except the shape's quantum
+template <typename Sink>
+static void run(const string& algorithm, const ArrivalOrder& workload, int quantum, Sink& sink) {
+    if (algorithm == "FCFS") {
+        FCFS().schedule(workload, sink);
+    } else if (algorithm == "SJF") {
+        SJF().schedule(workload, sink);
+    } else if (algorithm == "RR") {
+        RR().schedule(workload, quantum, sink);
+    } else if (algorithm == "Priority") {
+        Priority().schedule(workload, sink);
+    } else if (algorithm == "MLQ") {
+        MLQ().schedule(workload, 3, quantum, sink);
+    } else if (algorithm == "MLFQ") {
+        MLFQ(quantum, 3).schedule(workload, sink);
+    } else if (algorithm == "MLQ_Aging") {
+        MLQAging().schedule(workload, 3, quantum, 50, sink);
+    } else if (algorithm == "SJF_Aging") {
+        SJF_Aging().schedule(workload, 50, sink);
+    }
+}
+
+struct Measurement {
+    double seconds;      // fastest repetition
+    size_t peak_bytes;   // heap above what was live before the run
+    size_t allocations;  // heap allocations of the last repetition
+    size_t output_bytes;
+};
+
+// Runs one case until at least min_seconds have passed, and at least twice,
+// keeping the fastest repetition. Each run has a ScratchScope as a request
+// does, so from the second on the thread's arena is warm; the first one's
+// arena growth counts towards the peak, as do the sink and its output.
+static Measurement measure(const string& algorithm, const ArrivalOrder& workload, int quantum,
+                           bool delta_format, double min_seconds) {
+    Measurement result{0.0, 0, 0, 0};
+    double total = 0.0;
+    for (int repetition = 0; repetition < 2 || total < min_seconds; repetition++) {
+        size_t live_before = live_bytes;
+        size_t allocations_before = allocation_count;
+        peak_bytes = live_bytes;
+
+        auto start = chrono::steady_clock::now();
+        ScratchScope scratch;
+        JsonStreamSink sink;
+        if (delta_format) {
+            sink.useDeltaFormat();
+        }
+        run(algorithm, workload, quantum, sink);
+        string output = sink.finish("success");
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        total += seconds;
+        if (repetition == 0 || seconds < result.seconds) {
+            result.seconds = seconds;
+        }
+        result.peak_bytes = max(result.peak_bytes, peak_bytes - live_before);
+        result.allocations = allocation_count - allocations_before;
+        result.output_bytes = output.size();
+    }
+    return result;
+}
+
+// Fastest of as many calls to task as fit in min_seconds (at least one)
+template <typename Task>
+static double fastest(double min_seconds, Task task) {
+    double best = 0.0;
+    double total = 0.0;
+    for (int repetition = 0; repetition == 0 || total < min_seconds; repetition++) {
+        auto start = chrono::steady_clock::now();
+        task();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        total += seconds;
+        if (repetition == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+// Request body an API client would send for the workload
+static string requestBody(const ArrivalOrder& workload) {
+    json body;
+    body["scheduling_type"] = "FCFS";
+    body["processes"] = json::array();
+    for (const Process& p : workload.processes()) {
+        body["processes"].push_back({{"p_id", p.p_id}, {"arrival_time", p.arrival_time},
+                                     {"burst_time", p.burst_time}, {"priority", p.priority}});
+    }
+    return body.dump();
+}
+
+// Seconds spent in each phase of serving one request:
+//   decode     parsing the body and reading its processes, as the handlers do
+//   sort       ordering the workload by arrival
+//   schedule   the simulation alone, reporting to a sink that ignores it all
+//   build      assembling the nlohmann::json result (JsonSink, snapshot format)
+//   serialize  dump() of that result
+//   stream     encoding straight from the scheduler (JsonStreamSink), the
+//              path the endpoints take
+// build and stream are net of the schedule time.
+struct Phases {
+    double decode;
+    double sort;
+    double schedule;
+    double build;
+    double serialize;
+    double stream;
+
+    double total() const {
+        return decode + sort + schedule + build + serialize + stream;
+    }
+};
+
+static Phases measurePhases(const string& algorithm, const ArrivalOrder& workload, const string& body,
+                            int quantum, bool delta_format, double min_seconds) {
+    Phases result;
+    vector<Process> processes;
+    result.decode = fastest(min_seconds, [&] {
+        json input_json = json::parse(body);
+        processes.clear();
+        for (const auto& process : input_json.at("processes")) {
+            Process p;
+            p.p_id = process.at("p_id");
+            p.arrival_time = process.at("arrival_time");
+            p.burst_time = process.at("burst_time");
+            p.priority = process.value("priority", 0);
+            processes.push_back(p);
+        }
+    });
+    result.sort = fastest(min_seconds, [&] {
+        ArrivalOrder sorted(processes);
+    });
+    result.schedule = fastest(min_seconds, [&] {
+        ScratchScope scratch;
+        NullSink sink;
+        run(algorithm, workload, quantum, sink);
+    });
+
+    json output;
+    double built = fastest(min_seconds, [&] {
+        ScratchScope scratch;
+        JsonSink sink;
+        run(algorithm, workload, quantum, sink);
+        output = sink.result();
+    });
+    result.build = max(0.0, built - result.schedule);
+    result.serialize = fastest(min_seconds, [&] {
+        string text = output.dump();
+    });
+
+    double streamed = fastest(min_seconds, [&] {
+        ScratchScope scratch;
+        JsonStreamSink sink;
+        if (delta_format) {
+            sink.useDeltaFormat();
+        }
+        run(algorithm, workload, quantum, sink);
+        string text = sink.finish("success");
+    });
+    result.stream = max(0.0, streamed - result.schedule);
+    return result;
+}
+
+// Reference for the delta format, checked against by --check-delta: derives
+// the events of each Gantt row from its full ready-queue snapshot and the
+// previous row's, hashing and matching every waiting process on every row,
+// where ReadyQueueChanges only sees the changes the schedulers report. Lists
+// the events in the same order. Processes that stay in the same level keep
+// their relative order, except where the scheduler reordered them; those are
+// reported as a Dequeue and an Enqueue.
+class ReadyQueueDelta {
+private:
+    pmr::vector<pmr::vector<int>> previous;
+    pmr::unordered_map<int, pair<int, int>> previous_position;  // process id -> (level, index)
+    pmr::unordered_map<int, pair<int, bool>> current_state;     // process id -> (level, kept)
+    pmr::vector<pmr::vector<char>> kept;                         // per current entry: unchanged since the last row
+
+    // Working space of markKept(), kept between rows so a row allocates
+    // nothing once the buffers have grown to the largest queue
+    pmr::vector<int> slots;    // indices into current of entries that were in this level
+    pmr::vector<int> indices;  // their previous indices
+    pmr::vector<int> tails;
+    pmr::vector<int> parent;
+
+    // Marks the longest run of entries of `current` that already sat in the
+    // same level in the previous row in the same relative order
+    void markKept(int level, const pmr::vector<int>& current) {
+        slots.clear();
+        indices.clear();
+        for (int j = 0; j < static_cast<int>(current.size()); j++) {
+            auto found = previous_position.find(current[j]);
+            if (found != previous_position.end() && found->second.first == level) {
+                slots.push_back(j);
+                indices.push_back(found->second.second);
+            }
+        }
+
+        // Longest increasing subsequence of previous indices, with back links
+        tails.clear();
+        parent.assign(indices.size(), -1);
+        for (int k = 0; k < static_cast<int>(indices.size()); k++) {
+            auto it = lower_bound(tails.begin(), tails.end(), k, [&](int a, int b) {
+                return indices[a] < indices[b];
+            });
+            if (it != tails.begin()) {
+                parent[k] = *(it - 1);
+            }
+            if (it == tails.end()) {
+                tails.push_back(k);
+            } else {
+                *it = k;
+            }
+        }
+
+        kept[level].assign(current.size(), 0);
+        for (int k = tails.empty() ? -1 : tails.back(); k != -1; k = parent[k]) {
+            kept[level][slots[k]] = 1;
+        }
+    }
+
+public:
+    explicit ReadyQueueDelta(int levels = 1)
+        : previous(levels, scratchResource()), previous_position(scratchResource()),
+          current_state(scratchResource()), kept(levels, scratchResource()), slots(scratchResource()),
+          indices(scratchResource()), tails(scratchResource()), parent(scratchResource()) {}
+
+    void reset(int levels) {
+        previous.assign(levels, pmr::vector<int>());
+        kept.assign(levels, pmr::vector<char>());
+    }
+
+    // Appends the events that turn the previous snapshot into `current`.
+    void diff(int segment, int time, const pmr::vector<pmr::vector<int>>& current, pmr::vector<ReadyQueueEvent>& events) {
+        int levels = static_cast<int>(previous.size());
+
+        previous_position.clear();
+        for (int level = 0; level < levels; level++) {
+            for (int i = 0; i < static_cast<int>(previous[level].size()); i++) {
+                previous_position[previous[level][i]] = {level, i};
+            }
+        }
+        current_state.clear();
+        for (int level = 0; level < levels; level++) {
+            markKept(level, current[level]);
+            for (int j = 0; j < static_cast<int>(current[level].size()); j++) {
+                current_state[current[level][j]] = {level, kept[level][j] != 0};
+            }
+        }
+
+        // Removals: processes gone from the queues, or reordered within a level
+        for (int level = 0; level < levels; level++) {
+            for (int i = 0; i < static_cast<int>(previous[level].size()); i++) {
+                int id = previous[level][i];
+                auto found = current_state.find(id);
+                if (found != current_state.end() && (found->second.first != level || found->second.second)) {
+                    continue;  // unchanged, or reported as a promotion or demotion below
+                }
+                events.push_back({ReadyQueueEvent::Dequeue, segment, time, id, level, -1, -1});
+            }
+        }
+
+        // Insertions, in ascending position within each level
+        for (int level = 0; level < levels; level++) {
+            for (int j = 0; j < static_cast<int>(current[level].size()); j++) {
+                if (kept[level][j]) {
+                    continue;
+                }
+                int id = current[level][j];
+                auto found = previous_position.find(id);
+                if (found != previous_position.end() && found->second.first != level) {
+                    int from = found->second.first;
+                    events.push_back({level < from ? ReadyQueueEvent::Promote : ReadyQueueEvent::Demote,
+                                      segment, time, id, from, level, j});
+                } else {
+                    events.push_back({ReadyQueueEvent::Enqueue, segment, time, id, -1, level, j});
+                }
+            }
+        }
+
+        for (int level = 0; level < levels; level++) {
+            previous[level].assign(current[level].begin(), current[level].end());
+        }
+    }
+};
+
+// A ReadyQueueEvent as the delta format writes it
+static json eventJson(const ReadyQueueEvent& event, bool leveled) {
+    static const char* const type_names[] = {"enqueue", "dequeue", "promote", "demote"};
+    json result = {{"process_id", event.process_id}, {"segment", event.segment}, {"time", event.time},
+                   {"type", type_names[event.type]}};
+    if (leveled && event.from >= 0) {
+        result["from"] = event.from;
+    }
+    if (leveled && event.to >= 0) {
+        result["to"] = event.to;
+    }
+    if (event.position >= 0) {
+        result["position"] = event.position;
+    }
+    return result;
+}
+
+// Runs one case in the delta format and diffs the ready queues of a traced
+// run of it with ReadyQueueDelta. Returns the number of events, or -1 if the
+// two disagree.
+static long long checkDelta(const string& algorithm, const ArrivalOrder& workload, int quantum) {
+    ScratchScope scratch;
+    ScheduleTrace trace;
+    TraceSink trace_sink(trace);
+    run(algorithm, workload, quantum, trace_sink);
+
+    JsonStreamSink sink;
+    sink.useDeltaFormat();
+    run(algorithm, workload, quantum, sink);
+    json events = json::parse(sink.finish("success")).value("ready_queue_events", json::array());
+
+    // A leveled row without a snapshot has nothing waiting
+    bool leveled = trace.layout.ready != ReadyLayout::Flat;
+    int levels = max(trace.layout.levels, 1);
+    ReadyQueueDelta oracle(levels);
+    pmr::vector<ReadyQueueEvent> expected(scratchResource());
+    pmr::vector<pmr::vector<int>> queues(levels, scratchResource());
+    for (size_t row = 0; row < trace.segments(); row++) {
+        for (pmr::vector<int>& queue : queues) {
+            queue.clear();
+        }
+        for (size_t k = trace.ready_begin[row]; k < trace.ready_begin[row + 1]; k++) {
+            queues[max(trace.ready_level[k], 0)].push_back(trace.ready_ids[k]);
+        }
+        oracle.diff(static_cast<int>(row), trace.start_time[row], queues, expected);
+    }
+
+    if (events.size() != expected.size()) {
+        return -1;
+    }
+    for (size_t e = 0; e < expected.size(); e++) {
+        if (events[e] != eventJson(expected[e], leveled)) {
+            return -1;
+        }
+    }
+    return static_cast<long long>(expected.size());
+}
+
+// ns_per_process of a previous run, keyed by "algorithm,shape,processes"
+static map<string, double> readBaseline(const string& path) {
+    map<string, double> baseline;
+    ifstream file(path);
+    string line;
+    getline(file, line);  // header
+    while (getline(file, line)) {
+        vector<string> fields;
+        stringstream row(line);
+        string field;
+        while (getline(row, field, ',')) {
+            fields.push_back(field);
+        }
+        if (fields.size() >= 4) {
+            baseline[fields[0] + "," + fields[1] + "," + fields[2]] = stod(fields[3]);
+        }
+    }
+    return baseline;
+}
+
+static vector<string> split(const string& list) {
+    vector<string> items;
+    stringstream stream(list);
+    string item;
+    while (getline(stream, item, ',')) {
+        items.push_back(item);
+    }
+    return items;
+}
+
+static void usage() {
+    fprintf(stderr,
+            "usage: scheduler_bench [--max-count N] [--algorithms A,B,...] [--shapes S,T,...]\n"
+            "                       [--format snapshot|delta] [--budget SECONDS]\n"
+            "                       [--min-time SECONDS] [--baseline FILE | --phases | --check-delta]\n");
+}
+
+int main(int argc, char** argv) {
+    size_t max_count = 1000000;
+    vector<string> selected_algorithms = algorithms;
+    vector<string> selected_shapes;
+    bool delta_format = false;  // the endpoints' default
+    double budget = 10.0;
+    double min_seconds = 0.2;
+    string baseline_path;
+    bool phases = false;
+    bool check_delta = false;
+
+    for (int i = 1; i < argc; i++) {
+        string flag = argv[i];
+        if (flag == "--phases") {
+            phases = true;
+            continue;
+        }
+        if (flag == "--check-delta") {
+            check_delta = true;
+            continue;
+        }
+        if (flag == "--help" || i + 1 >= argc) {
+            usage();
+            return flag == "--help" ? 0 : 1;
+        }
+        string value = argv[++i];
+        if (flag == "--max-count") {
+            max_count = stoull(value);
+        } else if (flag == "--algorithms") {
+            selected_algorithms = split(value);
+        } else if (flag == "--shapes") {
+            selected_shapes = split(value);
+        } else if (flag == "--format" && (value == "delta" || value == "snapshot")) {
+            delta_format = value == "delta";
+        } else if (flag == "--budget") {
+            budget = stod(value);
+        } else if (flag == "--min-time") {
+            min_seconds = stod(value);
+        } else if (flag == "--baseline") {
+            baseline_path = value;
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    if (phases + !baseline_path.empty() + check_delta > 1) {
+        usage();
+        return 1;
+    }
+    map<string, double> baseline;
+    if (!baseline_path.empty()) {
+        baseline = readBaseline(baseline_path);
+    }
+
+    if (phases) {
+        printf("algorithm,shape,processes,decode_ns,sort_ns,schedule_ns,build_ns,serialize_ns,stream_ns\n");
+    } else if (check_delta) {
+        printf("algorithm,shape,processes,events,matches_diff\n");
+    } else {
+        printf("algorithm,shape,processes,ns_per_process,peak_bytes,allocations,output_bytes%s\n",
+               baseline_path.empty() ? "" : ",vs_baseline");
+    }
+    int mismatches = 0;
+    for (const Shape& shape : shapes()) {
+        if (!selected_shapes.empty() && find(selected_shapes.begin(), selected_shapes.end(), shape.name) == selected_shapes.end()) {
+            continue;
+        }
+        // A case is not repeated at the next size when its time, grown by
+        // the ratio seen over the last step (at least tenfold), would exceed
+        // the budget; the slowest schedulers grow faster than linearly
+        map<string, double> last_seconds;
+        map<string, bool> over_budget;
+        for (size_t count = 100; count <= max_count; count *= 10) {
+            WorkloadSpec spec = shape.spec;
+            spec.count = count;
+            ArrivalOrder workload(WorkloadGenerator(spec).generate());
+            string body = phases ? requestBody(workload) : string();
+
+            for (const string& algorithm : selected_algorithms) {
+                if (find(algorithms.begin(), algorithms.end(), algorithm) == algorithms.end()) {
+                    fprintf(stderr, "scheduler_bench: unknown algorithm %s\n", algorithm.c_str());
+                    return 1;
+                }
+                if (over_budget[algorithm]) {
+                    continue;
+                }
+
+                double seconds;
+                printf("%s,%s,%zu", algorithm.c_str(), shape.name.c_str(), count);
+                if (phases) {
+                    Phases p = measurePhases(algorithm, workload, body, shape.quantum, delta_format, min_seconds);
+                    double scale = 1e9 / count;
+                    printf(",%.1f,%.1f,%.1f,%.1f,%.1f,%.1f", p.decode * scale, p.sort * scale, p.schedule * scale,
+                           p.build * scale, p.serialize * scale, p.stream * scale);
+                    seconds = p.total();
+                } else if (check_delta) {
+                    auto start = chrono::steady_clock::now();
+                    long long events = checkDelta(algorithm, workload, shape.quantum);
+                    seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                    printf(",%lld,%s", max(events, 0LL), events >= 0 ? "yes" : "no");
+                    mismatches += events < 0;
+                } else {
+                    Measurement m = measure(algorithm, workload, shape.quantum, delta_format, min_seconds);
+                    double ns_per_process = m.seconds * 1e9 / count;
+                    printf(",%.1f,%zu,%zu,%zu", ns_per_process, m.peak_bytes, m.allocations, m.output_bytes);
+                    if (!baseline_path.empty()) {
+                        auto old = baseline.find(algorithm + "," + shape.name + "," + to_string(count));
+                        if (old != baseline.end() && old->second > 0.0) {
+                            printf(",%.2f", ns_per_process / old->second);
+                        } else {
+                            printf(",");
+                        }
+                    }
+                    seconds = m.seconds;
+                }
+                printf("\n");
+                fflush(stdout);
+
+                double growth = 10.0;
+                if (last_seconds[algorithm] > 0.0) {
+                    growth = max(growth, seconds / last_seconds[algorithm]);
+                }
+                last_seconds[algorithm] = seconds;
+                if (count * 10 <= max_count && seconds * growth > budget) {
+                    over_budget[algorithm] = true;
+                    fprintf(stderr, "scheduler_bench: %s on %s would take about %.0fs at %zu processes, skipping\n",
+                            algorithm.c_str(), shape.name.c_str(), seconds * growth, count * 10);
+                }
+            }
+        }
+    }
+    return mismatches > 0 ? 1 : 0;
+}
@@ -0,0 +1,96 @@
+// Command-line front end of WorkloadGenerator. Writes a request body with a
+// "processes" array to stdout, ready to POST to the scheduling endpoints.
+//
+//   g++ -std=c++17 -O2 -o workload_gen workload_gen.cpp
+//   ./workload_gen --count 1000000 --seed 7 --arrivals bursty --bursts pareto > workload.json
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "WorkloadGenerator.hpp"
+
+static void usage() {
+    fprintf(stderr,
+            "usage: workload_gen [--count N] [--seed S] [--arrivals poisson|bursty]\n"
+            "                    [--arrival-rate R] [--group-size G]\n"
+            "                    [--bursts exponential|lognormal|pareto] [--burst-mean M]\n"
+            "                    [--sigma S] [--alpha A] [--max-burst B]\n"
+            "                    [--priority-weights W0,W1,...] [--scheduling-type NAME]\n");
+}
+
+int main(int argc, char** argv) {
+    WorkloadSpec spec;
+    string scheduling_type;
+
+    for (int i = 1; i < argc; i++) {
+        string flag = argv[i];
+        if (flag == "--help" || i + 1 >= argc) {
+            usage();
+            return flag == "--help" ? 0 : 1;
+        }
+        string value = argv[++i];
+        if (flag == "--count") {
+            spec.count = stoull(value);
+        } else if (flag == "--seed") {
+            spec.seed = stoull(value);
+        } else if (flag == "--arrivals") {
+            spec.arrivals = value;
+        } else if (flag == "--arrival-rate") {
+            spec.arrival_rate = stod(value);
+        } else if (flag == "--group-size") {
+            spec.group_size = stod(value);
+        } else if (flag == "--bursts") {
+            spec.bursts = value;
+        } else if (flag == "--burst-mean") {
+            spec.burst_mean = stod(value);
+        } else if (flag == "--sigma") {
+            spec.sigma = stod(value);
+        } else if (flag == "--alpha") {
+            spec.alpha = stod(value);
+        } else if (flag == "--max-burst") {
+            spec.max_burst = stoi(value);
+        } else if (flag == "--priority-weights") {
+            spec.priority_weights.clear();
+            stringstream weights(value);
+            string weight;
+            while (getline(weights, weight, ',')) {
+                spec.priority_weights.push_back(stod(weight));
+            }
+        } else if (flag == "--scheduling-type") {
+            scheduling_type = value;
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    vector<Process> processes;
+    try {
+        processes = WorkloadGenerator(spec).generate();
+    } catch (const exception& e) {
+        fprintf(stderr, "workload_gen: %s\n", e.what());
+        return 1;
+    }
+
+    // Written by hand so millions of processes never sit in a json tree
+    string out = "{\"processes\":[";
+    for (size_t i = 0; i < processes.size(); i++) {
+        const Process& p = processes[i];
+        out += i > 0 ? ",{" : "{";
+        out += "\"arrival_time\":" + to_string(p.arrival_time) + ",\"burst_time\":" + to_string(p.burst_time) +
+               ",\"p_id\":" + to_string(p.p_id) + ",\"priority\":" + to_string(p.priority) + "}";
+        if (out.size() > (1 << 20)) {
+            fwrite(out.data(), 1, out.size(), stdout);
+            out.clear();
+        }
+    }
+    out += "]";
+    if (!scheduling_type.empty()) {
+        out += ",\"scheduling_type\":" + nlohmann::json(scheduling_type).dump();
+    }
+    out += "}\n";
+    fwrite(out.data(), 1, out.size(), stdout);
+    return 0;
+}